@@ -0,0 +1,106 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BitField.h"
+
+// Pieces shared by the benchmarks: seeded fields, timing samples and results printed one JSON object per line.
+namespace bench {
+
+typedef std::chrono::steady_clock Clock;
+
+inline double SecondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Every cell is alive with the given probability; the same seed gives the same field.
+inline BitField SeededField(size_t height, size_t width, double density, uint64_t seed) {
+    BitField field(height, width);
+    std::mt19937_64 gen(seed);
+    std::bernoulli_distribution bern(density);
+    for (size_t i = 0; i < height; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            field.Set(i, j, bern(gen));
+        }
+    }
+    return field;
+}
+
+// Per-generation latencies of a run, in seconds.
+class Latencies {
+public:
+    void Add(double seconds) {
+        samples_.push_back(seconds);
+    }
+
+    double Total() const {
+        double total = 0;
+        for (double sample: samples_) {
+            total += sample;
+        }
+        return total;
+    }
+
+    double Percentile(double q) {
+        if (samples_.empty()) {
+            return 0;
+        }
+        std::sort(samples_.begin(), samples_.end());
+        return samples_[std::min(samples_.size() - 1, static_cast<size_t> (q * samples_.size()))];
+    }
+
+private:
+    std::vector<double> samples_;
+};
+
+class JsonLine {
+public:
+    explicit JsonLine(const std::string& bench) {
+        Add("bench", bench);
+    }
+
+    JsonLine& Add(const std::string& key, const std::string& value) {
+        Key(key) << '"' << value << '"';
+        return *this;
+    }
+
+    JsonLine& Add(const std::string& key, double value) {
+        Key(key) << value;
+        return *this;
+    }
+
+    JsonLine& Add(const std::string& key, size_t value) {
+        Key(key) << value;
+        return *this;
+    }
+
+    // Throughput and the latency percentiles of a run over a height x width field, in microseconds.
+    JsonLine& AddRun(size_t height, size_t width, Latencies& latencies, size_t generations) {
+        Add("cells_per_sec", static_cast<double> (height) * width * generations / latencies.Total());
+        Add("p50_us", latencies.Percentile(0.5) * 1e6);
+        Add("p90_us", latencies.Percentile(0.9) * 1e6);
+        Add("p99_us", latencies.Percentile(0.99) * 1e6);
+        return *this;
+    }
+
+    void Print() {
+        std::cout << '{' << out_.str() << "}\n" << std::flush;
+    }
+
+private:
+    std::ostringstream& Key(const std::string& key) {
+        out_ << (out_.tellp() == 0 ? "" : ", ") << '"' << key << "\": ";
+        return out_;
+    }
+
+    std::ostringstream out_;
+};
+
+}  // namespace bench
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// Leaves the elements a vector adds without a value uninitialized, so that its pages are first written, and so
+// placed on a NUMA node, by whoever fills them in rather than by whoever allocated them.
+template<typename T>
+struct UntouchedAllocator : std::allocator<T> {
+    template<typename U>
+    struct rebind {
+        typedef UntouchedAllocator<U> other;
+    };
+
+    UntouchedAllocator() = default;
+
+    template<typename U>
+    UntouchedAllocator(const UntouchedAllocator<U>&) {
+    }
+
+    template<typename U>
+    void construct(U* p) {
+        ::new(static_cast<void*> (p)) U;
+    }
+
+    template<typename U, typename... Args>
+    void construct(U* p, Args&& ... args) {
+        ::new(static_cast<void*> (p)) U(std::forward<Args>(args)...);
+    }
+};
+
+// Field stored as one contiguous block of 64-bit words, cell (i, j) being bit j % 64 of word j / 64 of row i.
+// Bits past the width in the last word of each row are always kept zero.
+class BitField {
+public:
+    typedef uint64_t Word;
+    typedef std::vector<Word, UntouchedAllocator<Word>> Words;
+    static constexpr size_t kWordBits = 64;
+
+    BitField() = default;
+
+    BitField(const size_t height, const size_t width)
+            : height_{height}, width_{width}, words_per_row_{(width + kWordBits - 1) / kWordBits},
+              words_(height_ * words_per_row_, 0) {
+    }
+
+    // Takes over the words of a field laid out as above.
+    BitField(const size_t height, const size_t width, Words words)
+            : height_{height}, width_{width}, words_per_row_{(width + kWordBits - 1) / kWordBits},
+              words_(std::move(words)) {
+        words_.resize(height_ * words_per_row_, 0);
+    }
+
+    // A field whose words are left for the caller to write, row by row from the threads that will use them.
+    static BitField Untouched(const size_t height, const size_t width) {
+        BitField field;
+        field.height_ = height, field.width_ = width, field.words_per_row_ = (width + kWordBits - 1) / kWordBits;
+        field.words_.resize(height * field.words_per_row_);
+        return field;
+    }
+
+    size_t Height() const {
+        return height_;
+    }
+
+    size_t Width() const {
+        return width_;
+    }
+
+    size_t WordsPerRow() const {
+        return words_per_row_;
+    }
+
+    Word* Row(size_t i) {
+        return &words_[i * words_per_row_];
+    }
+
+    const Word* Row(size_t i) const {
+        return &words_[i * words_per_row_];
+    }
+
+    bool Get(size_t i, size_t j) const {
+        return (Row(i)[j / kWordBits] >> (j % kWordBits)) & 1;
+    }
+
+    void Set(size_t i, size_t j, bool value) {
+        Word& word = Row(i)[j / kWordBits];
+        Word bit = Word{1} << (j % kWordBits);
+        word = value ? (word | bit) : (word & ~bit);
+    }
+
+    bool operator==(const BitField& other) const {
+        return height_ == other.height_ && width_ == other.width_ && words_ == other.words_;
+    }
+
+    Word LastWordMask() const {
+        size_t tail = width_ % kWordBits;
+        return tail == 0 ? ~Word{0} : (Word{1} << tail) - 1;
+    }
+
+private:
+    size_t height_{0}, width_{0}, words_per_row_{0};
+    Words words_;
+};
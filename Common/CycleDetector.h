@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Hash of count words chained onto seed. Pieces of a field are hashed with their position in the seed, so the
+// hashes of the pieces can be combined in any order and content moving between pieces still shows.
+inline uint64_t HashWords(const uint64_t* words, size_t count, uint64_t seed) {
+    uint64_t hash = seed * 0x9E3779B97F4A7C15ULL;
+    for (size_t i = 0; i < count; ++i) {
+        hash = (hash ^ words[i]) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    return hash;
+}
+
+// Keeps a ring of the hashes of the generations sampled and tells when they start repeating. A period is only
+// reported once two whole periods of hashes, and at least two pairs of them, match, so a single collision cannot
+// fake one. Hashes taken every few generations only show periods that are multiples of the sampling interval,
+// the caller narrows the period down from there.
+class CycleDetector {
+public:
+    // Looks for periods of up to max_period generations among hashes taken every sample_interval generations.
+    explicit CycleDetector(size_t max_period = 0, size_t sample_interval = 1)
+            : max_period_{max_period}, max_lag_{max_period / std::max<size_t>(sample_interval, 1)} {
+    }
+
+    bool Enabled() const {
+        return max_period_ > 0;
+    }
+
+    // Records the hash of the field at generation, which must grow from call to call; returns the period in
+    // generations if the field is found to repeat, 0 otherwise.
+    size_t Record(uint64_t generation, uint64_t hash) {
+        ring_.push_back({generation, hash});
+        if (ring_.size() > max_lag_ + std::max<size_t>(max_lag_, 2)) {
+            ring_.pop_front();
+        }
+
+        const size_t last = ring_.size() - 1;
+        for (size_t lag = 1; lag + std::max<size_t>(lag, 2) <= ring_.size(); ++lag) {
+            const uint64_t period = ring_[last].generation - ring_[last - lag].generation;
+            if (period > max_period_) {
+                break;
+            }
+            bool repeats = true;
+            for (size_t i = 0; i < std::max<size_t>(lag, 2) && repeats; ++i) {
+                const Entry &later = ring_[last - i], &earlier = ring_[last - lag - i];
+                repeats = later.hash == earlier.hash && later.generation - earlier.generation == period;
+            }
+            if (repeats) {
+                return period;
+            }
+        }
+        return 0;
+    }
+
+private:
+    struct Entry {
+        uint64_t generation, hash;
+    };
+
+    size_t max_period_;
+    size_t max_lag_; // in samples
+    std::deque<Entry> ring_;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace tpcc {
+namespace solutions {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Sense-reversing barrier: arrival is a single atomic increment, waiters spin on the sense for a while
+// and then park on it (a futex on Linux), so threads waiting for long do not burn a core.
+class CyclicBarrier {
+public:
+    explicit CyclicBarrier(const size_t thread_count, const size_t spin_count = 1 << 12)
+            : all_thread_count_(static_cast<uint32_t> (thread_count)), spin_count_(spin_count) {
+    }
+
+    CyclicBarrier(const CyclicBarrier&) = delete;
+
+    CyclicBarrier(CyclicBarrier&&) = delete;
+
+    bool PassThrough() { // returns if thread was last
+        return PassThrough([] {});
+    }
+
+    // on_last runs in the last arriving thread before any other thread is let through.
+    template<typename Completion>
+    bool PassThrough(Completion&& on_last) {
+        const uint32_t sense = sense_.load(std::memory_order_relaxed);
+
+        if (arrived_thread_count_.fetch_add(1, std::memory_order_acq_rel) + 1 == all_thread_count_) {
+            arrived_thread_count_.store(0, std::memory_order_relaxed);
+            on_last();
+
+            sense_.store(sense ^ 1, std::memory_order_release);
+            sense_.notify_all();
+            return true;
+        }
+
+        for (size_t i = 0; i < spin_count_; ++i) {
+            if (sense_.load(std::memory_order_acquire) != sense) {
+                return false;
+            }
+            CpuRelax();
+        }
+        park_count_.fetch_add(1, std::memory_order_relaxed);
+        while (sense_.load(std::memory_order_acquire) == sense) {
+            sense_.wait(sense, std::memory_order_acquire);
+        }
+        return false;
+    }
+
+    // Waits that ran out of spinning and parked, for the statistics.
+    uint64_t ParkCount() const {
+        return park_count_.load(std::memory_order_relaxed);
+    }
+
+private:
+    const uint32_t all_thread_count_;
+    const size_t spin_count_;
+
+    alignas(64) std::atomic<uint32_t> arrived_thread_count_{0};
+    alignas(64) std::atomic<uint32_t> sense_{0};
+    alignas(64) std::atomic<uint64_t> park_count_{0};
+};
+
+} // namespace solutions
+} // namespace tpcc
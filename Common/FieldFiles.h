@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BitField.h"
+
+// Field files are read in a single pass over a memory mapping, straight into the packed words. The format follows
+// the extension: ".rle" is the usual Life RLE, ".bin" the binary format below, anything else is a CSV of 0s and 1s.
+//
+// Binary format: the 8 bytes of kBinaryMagic, then the height, the width and the generation of the field as
+// little-endian 64-bit integers, then the rows of the field exactly as BitField stores them.
+namespace field_files {
+
+constexpr char kBinaryMagic[8] = {'G', 'O', 'L', 'F', 'I', 'E', 'L', 'D'};
+constexpr size_t kBinaryHeader = sizeof(kBinaryMagic) + 3 * sizeof(uint64_t);
+
+// Read-only mapping of a whole file, advised for one sequential pass.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* data = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                data_ = static_cast<const char*> (data);
+                size_ = info.st_size;
+                madvise(data, size_, MADV_SEQUENTIAL);
+            }
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        if (data_) {
+            munmap(const_cast<char*> (data_), size_);
+        }
+    }
+
+    const char* Data() const {
+        return data_;
+    }
+
+    size_t Size() const {
+        return size_;
+    }
+
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+};
+
+inline const char* LineEnd(const char* p, const char* end) {
+    const void* newline = std::memchr(p, '\n', end - p);
+    return newline ? static_cast<const char*> (newline) : end;
+}
+
+inline bool HasExtension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(),
+                                                           extension) == 0;
+}
+
+// Every '0' or '1' of a line is a cell, anything else separates them; blank lines are skipped. The first line sets
+// the width, longer lines are cut to it.
+inline bool ParseCsv(const char* data, size_t size, BitField& field) {
+    typedef BitField::Word Word;
+    const char* end = data + size;
+    size_t width = 0;
+    for (const char* p = data; p != end && *p != '\n'; ++p) {
+        width += (*p == '0' || *p == '1');
+    }
+    if (width == 0) {
+        return false;
+    }
+
+    // Rows of a CSV are usually all alike, so the first one tells how many there are.
+    const size_t words_per_row = (width + BitField::kWordBits - 1) / BitField::kWordBits;
+    const size_t line_length = LineEnd(data, end) - data + 1;
+    BitField::Words words;
+    words.reserve((size / line_length + 1) * words_per_row);
+
+    size_t height = 0;
+    const char* p = data;
+    while (p != end) {
+        const char* line_end = LineEnd(p, end);
+        words.resize(words.size() + words_per_row, 0);
+        Word* row = words.data() + height * words_per_row;
+        size_t j = 0;
+        for (; p != line_end && j < width; ++p) {
+            if (*p == '0' || *p == '1') {
+                row[j / BitField::kWordBits] |= static_cast<Word> (*p == '1') << (j % BitField::kWordBits);
+                ++j;
+            }
+        }
+        if (j == 0) {
+            words.resize(words.size() - words_per_row);
+        } else {
+            ++height;
+        }
+        p = line_end == end ? end : line_end + 1;
+    }
+
+    field = BitField(height, width, std::move(words));
+    return true;
+}
+
+// Reads the "x = w, y = h" header after the comment lines, then runs of b (dead), any other letter (alive) and $
+// (end of row) up to the final '!'. Cells outside the declared box are dropped.
+inline bool ParseRle(const char* data, size_t size, BitField& field) {
+    const char* end = data + size;
+    const char* p = data;
+    while (p != end && (*p == '#' || *p == '\n' || *p == '\r')) {
+        while (p != end && *p != '\n') {
+            ++p;
+        }
+        if (p != end) {
+            ++p;
+        }
+    }
+
+    size_t sides[2] = {0, 0};
+    for (size_t k = 0; k < 2; ++k) {
+        while (p != end && *p != '=' && *p != '\n') {
+            ++p;
+        }
+        if (p == end || *p != '=') {
+            return false;
+        }
+        ++p;
+        while (p != end && *p == ' ') {
+            ++p;
+        }
+        while (p != end && *p >= '0' && *p <= '9') {
+            sides[k] = sides[k] * 10 + (*p++ - '0');
+        }
+    }
+    while (p != end && *p != '\n') { // the rule, if any
+        ++p;
+    }
+    if (sides[0] == 0 || sides[1] == 0) {
+        return false;
+    }
+
+    field = BitField(sides[1], sides[0]);
+    size_t i = 0, j = 0, count = 0;
+    for (; p != end && *p != '!'; ++p) {
+        char c = *p;
+        if (c >= '0' && c <= '9') {
+            count = count * 10 + (c - '0');
+            continue;
+        }
+        size_t run = count == 0 ? 1 : count;
+        count = 0;
+        if (c == '$') {
+            i += run, j = 0;
+        } else if (c == 'b') {
+            j += run;
+        } else if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+            for (size_t k = 0; k < run; ++k, ++j) {
+                if (i < field.Height() && j < field.Width()) {
+                    field.Set(i, j, true);
+                }
+            }
+        }
+    }
+    return true;
+}
+
+inline bool ParseBinary(const char* data, size_t size, BitField& field, uint64_t& generation) {
+    if (size < kBinaryHeader || std::memcmp(data, kBinaryMagic, sizeof(kBinaryMagic)) != 0) {
+        return false;
+    }
+    uint64_t header[3]; // height, width, generation
+    std::memcpy(header, data + sizeof(kBinaryMagic), sizeof(header));
+    const uint64_t height = header[0], width = header[1];
+    generation = header[2];
+    const uint64_t words_per_row = (width + BitField::kWordBits - 1) / BitField::kWordBits;
+    if (height == 0 || width == 0 || (size - kBinaryHeader) / sizeof(BitField::Word) / words_per_row < height) {
+        return false;
+    }
+
+    field = BitField(height, width);
+    const size_t bytes = height * words_per_row * sizeof(BitField::Word);
+    std::memcpy(field.Row(0), data + kBinaryHeader, bytes);
+    for (size_t i = 0; i < height; ++i) {
+        field.Row(i)[field.WordsPerRow() - 1] &= field.LastWordMask();
+    }
+    return true;
+}
+
+}  // namespace field_files
+
+// Returns false if the file cannot be read or is not a field of its format. Only binary files record a
+// generation, it is 0 for the others.
+inline bool ReadFieldFile(const std::string& path, BitField& field, uint64_t& generation) {
+    field_files::MappedFile file(path);
+    generation = 0;
+    if (!file.Data()) {
+        return false;
+    }
+    if (field_files::HasExtension(path, ".rle")) {
+        return field_files::ParseRle(file.Data(), file.Size(), field);
+    }
+    if (field_files::HasExtension(path, ".bin")) {
+        return field_files::ParseBinary(file.Data(), file.Size(), field, generation);
+    }
+    return field_files::ParseCsv(file.Data(), file.Size(), field);
+}
+
+// The field goes to path + ".part" first and only replaces path once complete, so a crash while writing
+// leaves the previous file at path intact.
+inline bool WriteBinaryField(const std::string& path, const BitField& field, uint64_t generation) {
+    const std::string part = path + ".part";
+    FILE* out = std::fopen(part.c_str(), "wb");
+    if (!out) {
+        return false;
+    }
+    uint64_t header[3] = {field.Height(), field.Width(), generation};
+    bool ok = std::fwrite(field_files::kBinaryMagic, sizeof(field_files::kBinaryMagic), 1, out) == 1 &&
+              std::fwrite(header, sizeof(header), 1, out) == 1 &&
+              (field.Height() == 0 || std::fwrite(field.Row(0), sizeof(BitField::Word),
+                                                  field.Height() * field.WordsPerRow(), out) ==
+                                      field.Height() * field.WordsPerRow());
+    ok = std::fclose(out) == 0 && ok;
+    return ok && std::rename(part.c_str(), path.c_str()) == 0;
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "BitField.h"
+#include "FieldFiles.h"
+
+// What STATUS shows: "[<x> <y> <w> <h>] [DENSITY <s>] [RAW]". The viewport is columns [x, x + w) of rows
+// [y, y + h), cut to the field; DENSITY draws one character per s x s block of it, darker the more cells are alive;
+// RAW writes the viewport as a binary field file instead of text.
+struct FieldView {
+    size_t col{0}, row{0};
+    size_t width{SIZE_MAX}, height{SIZE_MAX};
+    size_t scale{1};
+    bool raw{false};
+};
+
+// Reads the view up to the end of the line; returns false if it makes no sense.
+inline bool ReadFieldView(std::istream& in, FieldView& view) {
+    std::string line;
+    std::getline(in, line);
+    std::istringstream tokens(line);
+
+    std::string key;
+    while (tokens >> key) {
+        if (key == "DENSITY") {
+            if (!(tokens >> view.scale) || view.scale == 0) {
+                return false;
+            }
+        } else if (key == "RAW") {
+            view.raw = true;
+        } else {
+            std::istringstream number(key);
+            if (!(number >> view.col) || !(tokens >> view.row >> view.width >> view.height)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Renders a field into large preformatted chunks, each written out at once. Cells are drawn 8 at a time from
+// a table of the glyphs of every byte value.
+class FieldPrinter {
+public:
+    FieldPrinter(const std::string& dead, const std::string& alive)
+            : dead_(dead), alive_(alive) {
+        for (size_t byte = 0; byte < 256; ++byte) {
+            for (size_t bit = 0; bit < 8; ++bit) {
+                glyphs_[byte] += (byte >> bit) & 1 ? alive : dead;
+            }
+        }
+    }
+
+    void Print(const BitField& field, FieldView view) {
+        Clip(field, view);
+        std::string buffer;
+        buffer.reserve(kChunk + view.width * glyphs_[0].size());
+        for (size_t i = view.row; i < view.row + view.height; i += view.scale) {
+            if (view.scale == 1) {
+                AppendCells(field.Row(i), view, buffer);
+            } else {
+                AppendDensity(field, i, view, buffer);
+            }
+            buffer += '\n';
+            if (buffer.size() >= kChunk) {
+                std::cout.write(buffer.data(), static_cast<std::streamsize> (buffer.size()));
+                buffer.clear();
+            }
+        }
+        std::cout.write(buffer.data(), static_cast<std::streamsize> (buffer.size()));
+    }
+
+    // The viewport as a binary field file, see FieldFiles.h.
+    static void WriteRaw(const BitField& field, FieldView view, uint64_t generation) {
+        Clip(field, view);
+        const uint64_t header[3] = {view.height, view.width, generation};
+        std::cout.write(field_files::kBinaryMagic, sizeof(field_files::kBinaryMagic));
+        std::cout.write(reinterpret_cast<const char*> (header), sizeof(header));
+
+        const size_t words = (view.width + BitField::kWordBits - 1) / BitField::kWordBits;
+        std::vector<BitField::Word> buffer;
+        buffer.reserve(kChunk / sizeof(BitField::Word) + words);
+        for (size_t i = view.row; i < view.row + view.height; ++i) {
+            for (size_t w = 0; w < words; ++w) {
+                buffer.push_back(Bits(field.Row(i), view.col + w * BitField::kWordBits,
+                                      std::min(BitField::kWordBits, view.width - w * BitField::kWordBits)));
+            }
+            if (buffer.size() * sizeof(BitField::Word) >= kChunk || i + 1 == view.row + view.height) {
+                std::cout.write(reinterpret_cast<const char*> (buffer.data()),
+                                static_cast<std::streamsize> (buffer.size() * sizeof(BitField::Word)));
+                buffer.clear();
+            }
+        }
+        std::cout.flush();
+    }
+
+private:
+    static constexpr size_t kChunk = 1 << 20;
+    static constexpr char kDensityRamp[] = " .:-=+*#%@";
+
+    static void Clip(const BitField& field, FieldView& view) {
+        view.row = std::min(view.row, field.Height());
+        view.col = std::min(view.col, field.Width());
+        view.height = std::min(view.height, field.Height() - view.row);
+        view.width = std::min(view.width, field.Width() - view.col);
+    }
+
+    // count <= 64 cells of the row from column col on, which may straddle two words.
+    static BitField::Word Bits(const BitField::Word* row, size_t col, size_t count) {
+        const size_t shift = col % BitField::kWordBits;
+        BitField::Word bits = row[col / BitField::kWordBits] >> shift;
+        if (shift != 0 && shift + count > BitField::kWordBits) {
+            bits |= row[col / BitField::kWordBits + 1] << (BitField::kWordBits - shift);
+        }
+        return count == BitField::kWordBits ? bits : bits & ((BitField::Word{1} << count) - 1);
+    }
+
+    void AppendCells(const BitField::Word* row, const FieldView& view, std::string& buffer) const {
+        for (size_t j = 0; j < view.width; j += BitField::kWordBits) {
+            const size_t count = std::min(BitField::kWordBits, view.width - j);
+            BitField::Word bits = Bits(row, view.col + j, count);
+            size_t k = 0;
+            for (; k + 8 <= count; k += 8, bits >>= 8) {
+                buffer += glyphs_[bits & 0xFF];
+            }
+            for (; k < count; ++k, bits >>= 1) {
+                buffer += bits & 1 ? alive_ : dead_;
+            }
+        }
+    }
+
+    // One character per block of scale x scale cells starting at row i; any live cell makes it non-blank.
+    static void AppendDensity(const BitField& field, size_t i, const FieldView& view, std::string& buffer) {
+        const size_t rows = std::min(view.scale, view.row + view.height - i);
+        const size_t levels = sizeof(kDensityRamp) - 1;
+        for (size_t j = 0; j < view.width; j += view.scale) {
+            const size_t cols = std::min(view.scale, view.width - j);
+            size_t alive = 0;
+            for (size_t r = i; r < i + rows; ++r) {
+                for (size_t c = 0; c < cols; c += BitField::kWordBits) {
+                    alive += __builtin_popcountll(Bits(field.Row(r), view.col + j + c,
+                                                       std::min(BitField::kWordBits, cols - c)));
+                }
+            }
+            buffer += kDensityRamp[alive == 0 ? 0 : 1 + alive * (levels - 2) / (rows * cols)];
+        }
+    }
+
+    std::string dead_, alive_;
+    std::string glyphs_[256];
+};
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <istream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "LifeRule.h"
+
+// Optional settings that may follow the field description of START, given as "KEY value..." pairs.
+struct GameOptions {
+    enum class Engine {
+        kBitSliced, kHashLife, kSparse
+    };
+
+    static constexpr size_t kMinCacheNodes = 1 << 10;
+
+    Engine engine{Engine::kBitSliced};      // ENGINE <BITSLICED|HASHLIFE|SPARSE>
+    size_t tile_rows{128}, tile_cols{2048}; // TILE <rows> <cols>; cols are rounded up to whole words
+    size_t cache_nodes{1 << 22};            // CACHE <nodes>; HashLife collects garbage above it, at least
+                                            // kMinCacheNodes
+    size_t halo_depth{1};                   // HALO <k>; generations computed between two halo exchanges
+    bool gather_runs{false};                // GATHER <PACKED|RLE>; RLE sends runs of dead words as counts
+    size_t control_interval{16};            // CONTROL <n>; MPI workers look for commands every n generations
+    size_t threads{0};                      // THREADS <n>; compute threads per MPI worker, 0 for one per core
+    size_t checkpoint_interval{0};          // CHECKPOINT <n> <path>; saves the game every n generations,
+    std::string checkpoint_path;            // 0 for never
+    size_t trace_interval{0};               // TRACE <n> <path>; appends the STATS as a JSON line every n
+    std::string trace_path;                 // generations, 0 for never
+    life::Rule rule{life::kConwayRule};     // RULE <B.../S...>; one of life::kCompiledRules
+    size_t cycle_limit{0};                  // CYCLES <n>; skips ahead once the field repeats with a period of
+                                            // up to n generations, 0 for never looking; at least HALO's k
+    size_t rebalance_interval{0};           // REBALANCE <n>; MPI workers move rows between block rows every n
+                                            // generations, 0 for never
+    bool pin_threads{false};                // AFFINITY <cpus|AUTO|NONE>; the CPUs the workers are pinned to in
+    std::vector<size_t> affinity;           // turn, as in "0,2,8-15"; empty for those the process may run on
+};
+
+// Reads a list of CPUs such as "0,2,8-15", numbered below kMaxCpu.
+inline bool ParseCpuList(const std::string& text, std::vector<size_t>& cpus) {
+    constexpr size_t kMaxCpu = 1 << 16;
+    cpus.clear();
+    std::istringstream items(text);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        size_t from, to;
+        char dash;
+        std::istringstream range(item);
+        if (!(range >> from)) {
+            return false;
+        }
+        to = from;
+        if ((range >> dash && (dash != '-' || !(range >> to) || to < from)) || to >= kMaxCpu) {
+            return false;
+        }
+        for (size_t cpu = from; cpu <= to; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return !cpus.empty();
+}
+
+// Reads the options up to the end of the line; returns false and names the culprit in bad_key on failure.
+inline bool ReadGameOptions(std::istream& in, GameOptions& options, std::string& bad_key) {
+    std::string line;
+    std::getline(in, line);
+    std::istringstream tokens(line);
+
+    std::string key;
+    while (tokens >> key) {
+        bool read_ok = false;
+        if (key == "ENGINE") {
+            std::string engine;
+            tokens >> engine;
+            read_ok = engine == "BITSLICED" || engine == "HASHLIFE" || engine == "SPARSE";
+            options.engine = (engine == "HASHLIFE" ? GameOptions::Engine::kHashLife :
+                              engine == "SPARSE" ? GameOptions::Engine::kSparse : GameOptions::Engine::kBitSliced);
+        } else if (key == "TILE") {
+            read_ok = static_cast<bool> (tokens >> options.tile_rows >> options.tile_cols) &&
+                      options.tile_rows > 0 && options.tile_cols > 0;
+        } else if (key == "CACHE") {
+            read_ok = static_cast<bool> (tokens >> options.cache_nodes) &&
+                      options.cache_nodes >= GameOptions::kMinCacheNodes;
+        } else if (key == "HALO") {
+            read_ok = static_cast<bool> (tokens >> options.halo_depth) && options.halo_depth > 0;
+        } else if (key == "CONTROL") {
+            read_ok = static_cast<bool> (tokens >> options.control_interval) && options.control_interval > 0;
+        } else if (key == "THREADS") {
+            read_ok = static_cast<bool> (tokens >> options.threads);
+        } else if (key == "CHECKPOINT") {
+            read_ok = static_cast<bool> (tokens >> options.checkpoint_interval >> options.checkpoint_path) &&
+                      options.checkpoint_interval > 0;
+        } else if (key == "TRACE") {
+            read_ok = static_cast<bool> (tokens >> options.trace_interval >> options.trace_path) &&
+                      options.trace_interval > 0;
+        } else if (key == "CYCLES") {
+            read_ok = static_cast<bool> (tokens >> options.cycle_limit) && options.cycle_limit > 0;
+        } else if (key == "REBALANCE") {
+            read_ok = static_cast<bool> (tokens >> options.rebalance_interval) && options.rebalance_interval > 0;
+        } else if (key == "RULE") {
+            std::string rule;
+            tokens >> rule;
+            read_ok = life::ParseRule(rule, options.rule) && life::IsCompiled(options.rule);
+        } else if (key == "AFFINITY") {
+            std::string cpus;
+            tokens >> cpus;
+            options.pin_threads = cpus != "NONE";
+            options.affinity.clear();
+            read_ok = !options.pin_threads || cpus == "AUTO" || ParseCpuList(cpus, options.affinity);
+        } else if (key == "GATHER") {
+            std::string gather;
+            tokens >> gather;
+            read_ok = gather == "PACKED" || gather == "RLE";
+            options.gather_runs = (gather == "RLE");
+        }
+
+        if (!read_ok) {
+            bad_key = key;
+            return false;
+        }
+    }
+    // The field is only hashed once per block of HALO generations.
+    if (options.cycle_limit > 0 && options.cycle_limit < options.halo_depth) {
+        bad_key = "CYCLES";
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,363 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "BitField.h"
+#include "LifeRule.h"
+
+namespace life {
+
+typedef BitField::Word Word;
+
+// A rule fixed at compile time, so that every kernel below compiles down to the exact expression of that rule.
+template<uint32_t kBirth, uint32_t kSurvival>
+struct FixedRule {
+    static constexpr uint32_t birth = kBirth, survival = kSurvival;
+};
+
+typedef FixedRule<kConwayRule.birth, kConwayRule.survival> Conway;
+
+template<bool kSet, typename T>
+inline T Literal(T bits) {
+    if constexpr (kSet) {
+        return bits;
+    } else {
+        return ~bits;
+    }
+}
+
+// The cells whose neighbour count s3 s2 s1 s0 is n and which the rule keeps or makes alive. A count of 8 is the
+// only one with s3 set, so s3 only needs to be looked at for 0 and 8.
+template<typename R, size_t n, typename T>
+inline T RuleTerm(T s0, T s1, T s2, T s3, T mid) {
+    constexpr bool born = (R::birth >> n) & 1, survives = (R::survival >> n) & 1;
+    if constexpr (!born && !survives) {
+        return T{};
+    } else {
+        T count_is_n;
+        if constexpr (n == 8) {
+            count_is_n = s3;
+        } else {
+            count_is_n = Literal<(n & 1) != 0>(s0) & Literal<(n & 2) != 0>(s1) & Literal<(n & 4) != 0>(s2);
+            if constexpr (n == 0) {
+                count_is_n &= ~s3;
+            }
+        }
+        if constexpr (born && survives) {
+            return count_is_n;
+        } else if constexpr (born) {
+            return count_is_n & ~mid;
+        } else {
+            return count_is_n & mid;
+        }
+    }
+}
+
+template<typename R, typename T, size_t... n>
+inline T ApplyRule(T s0, T s1, T s2, T s3, T mid, std::index_sequence<n...>) {
+    return (RuleTerm<R, n>(s0, s1, s2, s3, mid) | ...);
+}
+
+// Adds up the eight neighbour bit-planes with a tree of full adders and applies the rule to every bit at once.
+// x_w holds the west neighbour of each cell of x (x shifted towards higher columns), x_e the east one.
+template<typename R, typename T>
+inline T NextCells(T up_w, T up, T up_e, T mid_w, T mid, T mid_e, T down_w, T down, T down_e) {
+    T u0 = up_w ^ up ^ up_e, u1 = (up_w & up) | (up_e & (up_w ^ up));
+    T m0 = mid_w ^ mid_e, m1 = mid_w & mid_e;
+    T d0 = down_w ^ down ^ down_e, d1 = (down_w & down) | (down_e & (down_w ^ down));
+
+    T s0 = u0 ^ m0 ^ d0, c1 = (u0 & m0) | (d0 & (u0 ^ m0));
+    T t0 = u1 ^ m1 ^ d1, t1 = (u1 & m1) | (d1 & (u1 ^ m1));
+    T s1 = t0 ^ c1, c2 = t0 & c1;
+    T s2 = t1 ^ c2, s3 = t1 & c2;
+
+    if constexpr (std::is_same_v<R, Conway>) { // 2 or 3 neighbours, and 2 only if alive
+        return s1 & ~s2 & ~s3 & (s0 | mid);
+    } else {
+        return ApplyRule<R>(s0, s1, s2, s3, mid, std::make_index_sequence<9>());
+    }
+}
+
+#if defined(__GNUC__)
+// Several words processed as one value, as wide as the widest vector register of the target.
+#if defined(__AVX512F__)
+constexpr size_t kVectorBytes = 64;
+#elif defined(__AVX__)
+constexpr size_t kVectorBytes = 32;
+#else
+constexpr size_t kVectorBytes = 16;
+#endif
+typedef Word WordVector __attribute__((vector_size(kVectorBytes)));
+constexpr size_t kVectorWords = sizeof(WordVector) / sizeof(Word);
+
+inline WordVector LoadVector(const Word* from) {
+    WordVector vector;
+    std::memcpy(&vector, from, sizeof(vector));
+    return vector;
+}
+
+inline void StoreVector(Word* to, const WordVector& vector) {
+    std::memcpy(to, &vector, sizeof(vector));
+}
+#endif
+
+inline Word GetBit(const Word* row, size_t j) {
+    return (row[j / BitField::kWordBits] >> (j % BitField::kWordBits)) & 1;
+}
+
+// West neighbours of the cells of word w; west_in is the cell to the west of column 0.
+inline Word WestOf(const Word* row, size_t w, Word west_in) {
+    return (row[w] << 1) | (w > 0 ? row[w - 1] >> (BitField::kWordBits - 1) : west_in);
+}
+
+// East neighbours of the cells of word w; east_in is the cell to the east of the last column.
+inline Word EastOf(const Word* row, size_t w, size_t width, Word east_in) {
+    size_t word_count = (width + BitField::kWordBits - 1) / BitField::kWordBits;
+    if (w + 1 < word_count) {
+        return (row[w] >> 1) | (row[w + 1] << (BitField::kWordBits - 1));
+    }
+    return (row[w] >> 1) | (east_in << ((width - 1) % BitField::kWordBits));
+}
+
+// Computes words [w_from, w_to) of the next state of row mid. With torus set the row wraps around horizontally,
+// otherwise cells beyond its ends are dead. Returns whether any of these words changed.
+template<typename R>
+inline bool StepRow(const Word* up, const Word* mid, const Word* down, Word* out,
+                    size_t width, size_t w_from, size_t w_to, bool torus) {
+    const size_t word_count = (width + BitField::kWordBits - 1) / BitField::kWordBits;
+    const size_t last = width - 1;
+
+    Word up_w_in = torus ? GetBit(up, last) : 0, up_e_in = torus ? GetBit(up, 0) : 0;
+    Word mid_w_in = torus ? GetBit(mid, last) : 0, mid_e_in = torus ? GetBit(mid, 0) : 0;
+    Word down_w_in = torus ? GetBit(down, last) : 0, down_e_in = torus ? GetBit(down, 0) : 0;
+
+    const size_t tail = width % BitField::kWordBits;
+    const Word last_word_mask = (tail == 0 ? ~Word{0} : (Word{1} << tail) - 1);
+
+    Word changed = 0;
+    auto scalar_step = [&](size_t w) {
+        out[w] = NextCells<R>(WestOf(up, w, up_w_in), up[w], EastOf(up, w, width, up_e_in),
+                              WestOf(mid, w, mid_w_in), mid[w], EastOf(mid, w, width, mid_e_in),
+                              WestOf(down, w, down_w_in), down[w], EastOf(down, w, width, down_e_in));
+        if (w + 1 == word_count) {
+            out[w] &= last_word_mask;
+        }
+        changed |= out[w] ^ mid[w];
+    };
+
+    // Words strictly inside the row have both neighbour words available, so no wrap handling is needed there:
+    // only the first and the last word of the row take the ghost cells.
+    size_t w = w_from;
+    for (; w < w_to && w == 0; ++w) {
+        scalar_step(w);
+    }
+    constexpr int kHigh = BitField::kWordBits - 1;
+#if defined(__GNUC__)
+    WordVector changed_vector{};
+    for (; w + kVectorWords <= w_to && w + kVectorWords < word_count; w += kVectorWords) {
+        WordVector up_c = LoadVector(up + w), mid_c = LoadVector(mid + w), down_c = LoadVector(down + w);
+        WordVector up_w = (up_c << 1) | (LoadVector(up + w - 1) >> kHigh);
+        WordVector mid_w = (mid_c << 1) | (LoadVector(mid + w - 1) >> kHigh);
+        WordVector down_w = (down_c << 1) | (LoadVector(down + w - 1) >> kHigh);
+        WordVector up_e = (up_c >> 1) | (LoadVector(up + w + 1) << kHigh);
+        WordVector mid_e = (mid_c >> 1) | (LoadVector(mid + w + 1) << kHigh);
+        WordVector down_e = (down_c >> 1) | (LoadVector(down + w + 1) << kHigh);
+
+        WordVector next = NextCells<R>(up_w, up_c, up_e, mid_w, mid_c, mid_e, down_w, down_c, down_e);
+        changed_vector |= next ^ mid_c;
+        StoreVector(out + w, next);
+    }
+    for (size_t k = 0; k < kVectorWords; ++k) {
+        changed |= changed_vector[k];
+    }
+#endif
+    for (; w < w_to && w + 1 < word_count; ++w) {
+        out[w] = NextCells<R>((up[w] << 1) | (up[w - 1] >> kHigh), up[w], (up[w] >> 1) | (up[w + 1] << kHigh),
+                              (mid[w] << 1) | (mid[w - 1] >> kHigh), mid[w], (mid[w] >> 1) | (mid[w + 1] << kHigh),
+                              (down[w] << 1) | (down[w - 1] >> kHigh), down[w],
+                              (down[w] >> 1) | (down[w + 1] << kHigh));
+        changed |= out[w] ^ mid[w];
+    }
+    for (; w < w_to; ++w) {
+        scalar_step(w);
+    }
+    return changed != 0;
+}
+
+// Computes rows [row_from, row_to) and words [w_from, w_to) of the next generation of a toroidal field.
+// Returns whether anything in there changed.
+template<typename R>
+inline bool StepTorus(const BitField& cur, BitField& next, size_t row_from, size_t row_to,
+                      size_t w_from, size_t w_to) {
+    const size_t height = cur.Height();
+    bool changed = false;
+    for (size_t i = row_from; i < row_to; ++i) {
+        changed |= StepRow<R>(cur.Row((i + height - 1) % height), cur.Row(i), cur.Row((i + 1) % height), next.Row(i),
+                              cur.Width(), w_from, w_to, true);
+    }
+    return changed;
+}
+
+// Up to 64 cells of a row starting at column col, wrapping around the row width.
+inline Word ReadBits(const Word* row, size_t width, size_t col, size_t count) {
+    Word bits = 0;
+    col %= width;
+    for (size_t done = 0; done < count;) {
+        size_t piece = std::min({count - done, width - col, BitField::kWordBits - col % BitField::kWordBits});
+        Word part = row[col / BitField::kWordBits] >> (col % BitField::kWordBits);
+        if (piece < BitField::kWordBits) {
+            part &= (Word{1} << piece) - 1;
+        }
+        bits |= part << done;
+        done += piece;
+        col = (col + piece) % width;
+    }
+    return bits;
+}
+
+// Overwrites count <= 64 cells of a row starting at column col with the low bits of bits.
+inline void WriteBits(Word* row, size_t col, Word bits, size_t count) {
+    const size_t shift = col % BitField::kWordBits;
+    const Word mask = (count == BitField::kWordBits ? ~Word{0} : (Word{1} << count) - 1);
+    bits &= mask;
+
+    Word& first = row[col / BitField::kWordBits];
+    first = (first & ~(mask << shift)) | (bits << shift);
+    if (shift + count > BitField::kWordBits) {
+        Word& second = row[col / BitField::kWordBits + 1];
+        Word second_mask = (Word{1} << (shift + count - BitField::kWordBits)) - 1;
+        second = (second & ~second_mask) | (bits >> (BitField::kWordBits - shift));
+    }
+}
+
+// Working copies of a tile together with its surroundings, see StepTorusTile.
+struct TileScratch {
+    BitField from, to;
+};
+
+// Advances rows [row_from, row_to) and words [w_from, w_to) of a toroidal field by steps <= 64 generations
+// at once. The tile is copied into scratch with steps rows and one word of cells around it; every generation
+// the valid part of the copy shrinks by a cell on each side, so the tile itself stays exact while it never
+// leaves the cache. Returns whether the tile changed in any of these generations.
+template<typename R>
+inline bool StepTorusTile(const BitField& cur, BitField& next, size_t row_from, size_t row_to,
+                          size_t w_from, size_t w_to, size_t steps, TileScratch& scratch) {
+    if (steps == 1) {
+        return StepTorus<R>(cur, next, row_from, row_to, w_from, w_to);
+    }
+
+    constexpr size_t kBits = BitField::kWordBits;
+    const size_t height = cur.Height(), width = cur.Width();
+    const size_t col_from = w_from * kBits, tile_bits = std::min(w_to * kBits, width) - col_from;
+    const size_t tile_rows = row_to - row_from, tile_words = w_to - w_from;
+    const size_t rows = tile_rows + 2 * steps, local_width = tile_bits + 2 * kBits;
+
+    if (scratch.from.Height() != rows || scratch.from.Width() != local_width) {
+        scratch.from = BitField(rows, local_width);
+        scratch.to = BitField(rows, local_width);
+    }
+
+    const size_t west_col = (col_from + width - kBits % width) % width, east_col = (col_from + tile_bits) % width;
+    for (size_t r = 0; r < rows; ++r) {
+        const Word* src = cur.Row((row_from + r + height - steps % height) % height);
+        Word* dst = scratch.from.Row(r);
+
+        dst[0] = ReadBits(src, width, west_col, kBits);
+        std::copy(src + w_from, src + w_to, dst + 1);
+        WriteBits(dst, kBits + tile_bits, ReadBits(src, width, east_col, kBits), kBits);
+    }
+
+    const Word tile_tail_mask = (tile_bits % kBits == 0 ? ~Word{0} : (Word{1} << (tile_bits % kBits)) - 1);
+    Word changed = 0;
+    for (size_t s = 1; s <= steps; ++s) {
+        const BitField& from = scratch.from;
+        BitField& to = scratch.to;
+        for (size_t r = s; r + s < rows; ++r) {
+            StepRow<R>(from.Row(r - 1), from.Row(r), from.Row(r + 1), to.Row(r), local_width, 0, to.WordsPerRow(),
+                       false);
+        }
+        for (size_t r = steps; r < steps + tile_rows; ++r) {
+            for (size_t w = 1; w <= tile_words; ++w) {
+                changed |= (from.Row(r)[w] ^ to.Row(r)[w]) & (w == tile_words ? tile_tail_mask : ~Word{0});
+            }
+        }
+        std::swap(scratch.from, scratch.to);
+    }
+
+    for (size_t r = 0; r < tile_rows; ++r) {
+        const Word* src = scratch.from.Row(steps + r);
+        Word* dst = next.Row(row_from + r);
+        std::copy(src + 1, src + 1 + tile_words, dst + w_from);
+        if (w_to == next.WordsPerRow()) {
+            dst[w_to - 1] &= next.LastWordMask();
+        }
+    }
+    return changed != 0;
+}
+
+// The centre 2x2 cells of every 4x4 block one generation on, for code that steps cells a few at a time rather
+// than a word at a time. Block bit 4 * i + j is the cell at row i, column j; centre bit 2 * i + j is the cell at
+// row i + 1, column j + 1. Constexpr, so that a table of a fixed rule can be built by the compiler.
+class BlockTable {
+public:
+    constexpr explicit BlockTable(const Rule& rule) {
+        for (uint32_t block = 0; block < kBlocks; ++block) {
+            uint8_t centre = 0;
+            for (uint32_t k = 0; k < 4; ++k) {
+                const uint32_t cell = (1 + k / 2) * 4 + 1 + k % 2;
+                const uint32_t around = (0x7u << (cell - 5)) | (0x5u << (cell - 1)) | (0x7u << (cell + 3));
+                const uint32_t count = std::popcount(block & around);
+                centre |= ((((block >> cell) & 1) != 0 ? rule.survival : rule.birth) >> count & 1) << k;
+            }
+            centres_[block] = centre;
+        }
+    }
+
+    uint8_t Centre(uint32_t block) const {
+        return centres_[block];
+    }
+
+private:
+    static constexpr uint32_t kBlocks = 1 << 16;
+
+    uint8_t centres_[kBlocks]{};
+};
+
+template<typename Visit, size_t... k>
+inline bool VisitRule(const Rule& rule, Visit& visit, std::index_sequence<k...>) {
+    return ((rule == kCompiledRules[k] &&
+             (visit(FixedRule<kCompiledRules[k].birth, kCompiledRules[k].survival>()), true)) || ...);
+}
+
+// Calls visit with the FixedRule of rule; returns false if rule is not among kCompiledRules.
+template<typename Visit>
+inline bool VisitRule(const Rule& rule, Visit&& visit) {
+    return VisitRule(rule, visit, std::make_index_sequence<std::size(kCompiledRules)>());
+}
+
+// The kernels of a rule chosen at run time. One call covers a whole tile or row, so the indirection costs
+// nothing next to the cells.
+typedef bool (*TileStepper)(const BitField& cur, BitField& next, size_t row_from, size_t row_to,
+                            size_t w_from, size_t w_to, size_t steps, TileScratch& scratch);
+typedef bool (*RowStepper)(const Word* up, const Word* mid, const Word* down, Word* out,
+                           size_t width, size_t w_from, size_t w_to, bool torus);
+
+inline TileStepper TileStepperFor(const Rule& rule) {
+    TileStepper stepper = nullptr;
+    VisitRule(rule, [&stepper](auto fixed) { stepper = &StepTorusTile<decltype(fixed)>; });
+    return stepper;
+}
+
+inline RowStepper RowStepperFor(const Rule& rule) {
+    RowStepper stepper = nullptr;
+    VisitRule(rule, [&stepper](auto fixed) { stepper = &StepRow<decltype(fixed)>; });
+    return stepper;
+}
+
+} // namespace life
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace life {
+
+// A Life-like rule in B/S notation, "B3/S23" for Conway's Life: bit n of birth is set if a dead cell with n live
+// neighbours comes alive, bit n of survival if a live one with n live neighbours stays alive.
+struct Rule {
+    uint32_t birth, survival;
+
+    constexpr bool operator==(const Rule& other) const {
+        return birth == other.birth && survival == other.survival;
+    }
+};
+
+// The set of neighbour counts in digits, as in "23".
+constexpr uint32_t Counts(const char* digits) {
+    uint32_t counts = 0;
+    for (; *digits; ++digits) {
+        counts |= 1u << (*digits - '0');
+    }
+    return counts;
+}
+
+constexpr Rule kConwayRule{Counts("3"), Counts("23")};
+
+// The rules there is a kernel for, see LifeKernel.h. Any other rule is one more line here.
+constexpr Rule kCompiledRules[] = {
+        kConwayRule,
+        {Counts("36"), Counts("23")},       // HighLife
+        {Counts("2"), Counts("")},          // Seeds
+        {Counts("3678"), Counts("34678")},  // Day & Night
+        {Counts("3"), Counts("012345678")}, // Life without death
+        {Counts("36"), Counts("125")},      // 2x2
+        {Counts("3"), Counts("12345")},     // Maze
+        {Counts("368"), Counts("245")},     // Morley
+        {Counts("1357"), Counts("1357")},   // Replicator
+        {Counts("4678"), Counts("35678")},  // Anneal
+};
+
+inline bool IsCompiled(const Rule& rule) {
+    for (const Rule& compiled: kCompiledRules) {
+        if (compiled == rule) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Reads "B<digits>/S<digits>", digits 0 to 8 in any order. B0 is refused: the dead space around and between the
+// blocks of a field would come alive.
+inline bool ParseRule(const std::string& text, Rule& rule) {
+    rule = Rule{0, 0};
+    const size_t slash = text.find('/');
+    if (text.size() < 3 || text[0] != 'B' || slash == std::string::npos || slash + 1 == text.size() ||
+        text[slash + 1] != 'S') {
+        return false;
+    }
+    for (size_t k = 1; k < text.size(); ++k) {
+        if (k == slash || k == slash + 1) {
+            continue;
+        }
+        if (text[k] < '0' || text[k] > '8') {
+            return false;
+        }
+        (k < slash ? rule.birth : rule.survival) |= 1u << (text[k] - '0');
+    }
+    return (rule.birth & 1) == 0;
+}
+
+inline std::string RuleName(const Rule& rule) {
+    std::string name = "B";
+    for (int n = 0; n <= 8; ++n) {
+        if ((rule.birth >> n) & 1) {
+            name += static_cast<char> ('0' + n);
+        }
+    }
+    name += "/S";
+    for (int n = 0; n <= 8; ++n) {
+        if ((rule.survival >> n) & 1) {
+            name += static_cast<char> ('0' + n);
+        }
+    }
+    return name;
+}
+
+}  // namespace life
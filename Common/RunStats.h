@@ -0,0 +1,90 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+inline uint64_t NowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Where the time of a running game goes, as shown by STATS and written to the TRACE file.
+struct WorkerStats { // one thread of the Threads build, one process of the MPI build
+    static constexpr size_t kFields = 6;
+
+    uint64_t compute_ns{0};     // computing cells, packing halos included
+    uint64_t wait_ns{0};        // blocked in the barrier for the other threads
+    uint64_t exchange_ns{0};    // blocked in MPI for the halo
+    uint64_t control_ns{0};     // looking for and handling commands
+    uint64_t bytes_sent{0}, bytes_received{0};
+
+    // As an array of kFields numbers, for MPI.
+    void Save(uint64_t* to) const {
+        uint64_t fields[kFields] = {compute_ns, wait_ns, exchange_ns, control_ns, bytes_sent, bytes_received};
+        std::copy(fields, fields + kFields, to);
+    }
+
+    void Load(const uint64_t* from) {
+        compute_ns = from[0], wait_ns = from[1], exchange_ns = from[2], control_ns = from[3];
+        bytes_sent = from[4], bytes_received = from[5];
+    }
+};
+
+struct RunStats {
+    static constexpr size_t kGatheredFields = 2 + WorkerStats::kFields;
+
+    bool distributed{false};  // processes of the MPI build rather than threads
+    uint64_t generations{0};  // since START
+    double seconds{0};        // spent computing them, time waiting for RUN excluded
+    uint64_t parks{0};        // barrier waits that ran out of spinning and went to sleep
+    std::vector<WorkerStats> workers;
+
+    // Stats of MPI processes gathered as kGatheredFields numbers each: generations, running time in ns, then the
+    // WorkerStats. The generations are those of the first process, the time that of the slowest.
+    static RunStats Gathered(const uint64_t* from, size_t processes) {
+        RunStats stats;
+        stats.distributed = true;
+        stats.generations = processes == 0 ? 0 : from[0];
+        stats.workers.resize(processes);
+        for (size_t i = 0; i < processes; ++i, from += kGatheredFields) {
+            stats.seconds = std::max(stats.seconds, from[1] / 1e9);
+            stats.workers[i].Load(from + 2);
+        }
+        return stats;
+    }
+
+    void Print(std::ostream& out) const {
+        out << "Computed " << generations << " generation(s) in " << seconds << " s, "
+            << (seconds == 0 ? 0.0 : generations / seconds) << " generations/s.\n";
+        if (!distributed) {
+            out << "Barrier waits parked " << parks << " time(s).\n";
+        }
+        for (size_t i = 0; i < workers.size(); ++i) {
+            const WorkerStats& worker = workers[i];
+            out << (distributed ? "Process " : "Thread ") << (distributed ? i + 1 : i) << ": compute "
+                << worker.compute_ns / 1e6 << " ms, barrier " << worker.wait_ns / 1e6 << " ms";
+            if (distributed) {
+                out << ", halo wait " << worker.exchange_ns / 1e6 << " ms, control " << worker.control_ns / 1e6
+                    << " ms, sent " << worker.bytes_sent << " B, received " << worker.bytes_received << " B";
+            }
+            out << ".\n";
+        }
+    }
+
+    void PrintJson(std::ostream& out) const {
+        out << "{\"generations\": " << generations << ", \"seconds\": " << seconds << ", \"parks\": " << parks
+            << ", \"workers\": [";
+        for (size_t i = 0; i < workers.size(); ++i) {
+            const WorkerStats& worker = workers[i];
+            out << (i == 0 ? "" : ", ") << "{\"compute_ns\": " << worker.compute_ns << ", \"wait_ns\": "
+                << worker.wait_ns << ", \"exchange_ns\": " << worker.exchange_ns << ", \"control_ns\": "
+                << worker.control_ns << ", \"bytes_sent\": " << worker.bytes_sent << ", \"bytes_received\": "
+                << worker.bytes_received << '}';
+        }
+        out << "]}\n";
+    }
+};
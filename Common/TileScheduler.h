@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Cuts the field into rectangular tiles and hands them out to the workers once per generation.
+// Every worker owns a deque of neighbouring tiles: it pops them from the front and, once it runs dry,
+// steals from the back of the other deques.
+class TileScheduler {
+public:
+    struct Tile {
+        size_t row_from, row_to; // rows of the field
+        size_t w_from, w_to;     // words of a row
+    };
+
+    TileScheduler(const size_t height, const size_t word_count, const size_t tile_rows, const size_t tile_words)
+            : row_tiles_{(height + tile_rows - 1) / tile_rows}, col_tiles_{(word_count + tile_words - 1) / tile_words} {
+        for (size_t r = 0; r < row_tiles_; ++r) {
+            for (size_t c = 0; c < col_tiles_; ++c) {
+                tiles_.push_back({r * tile_rows, std::min(height, (r + 1) * tile_rows),
+                                  c * tile_words, std::min(word_count, (c + 1) * tile_words)});
+            }
+        }
+    }
+
+    TileScheduler(const TileScheduler&) = delete;
+
+    TileScheduler(TileScheduler&&) = delete;
+
+    size_t TileCount() const {
+        return tiles_.size();
+    }
+
+    size_t RowTiles() const {
+        return row_tiles_;
+    }
+
+    size_t ColTiles() const {
+        return col_tiles_;
+    }
+
+    const Tile& GetTile(size_t index) const {
+        return tiles_[index];
+    }
+
+    // The tile row_shift tiles down and col_shift tiles right of the given one, wrapping around the torus.
+    size_t Neighbour(size_t index, int row_shift, int col_shift) const {
+        size_t r = (index / col_tiles_ + row_tiles_ + row_shift) % row_tiles_;
+        size_t c = (index % col_tiles_ + col_tiles_ + col_shift) % col_tiles_;
+        return r * col_tiles_ + c;
+    }
+
+    void SetWorkerCount(size_t worker_count) {
+        deques_ = std::vector<TileDeque>(worker_count);
+    }
+
+    // The tiles [from, to) a worker starts every generation with, neighbouring rows of the field.
+    void GetShare(size_t worker, size_t& from, size_t& to) const {
+        from = TileCount() * worker / deques_.size();
+        to = TileCount() * (worker + 1) / deques_.size();
+    }
+
+    // Gives every worker back its share of the tiles; must not run concurrently with Next.
+    void Refill() {
+        for (size_t i = 0; i < deques_.size(); ++i) {
+            size_t from, to;
+            GetShare(i, from, to);
+            deques_[i].Reset(from, to);
+        }
+    }
+
+    // Returns false once there is no tile left anywhere for this generation.
+    bool Next(size_t worker, size_t& tile) {
+        if (deques_[worker].PopFront(tile)) {
+            return true;
+        }
+        for (size_t shift = 1; shift < deques_.size(); ++shift) {
+            if (deques_[(worker + shift) % deques_.size()].StealBack(tile)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    // No tiles are ever pushed during a generation, so a deque is just a range of tile indices:
+    // both ends live in one atomic word and are moved with compare-and-swap.
+    class alignas(64) TileDeque {
+    public:
+        void Reset(size_t from, size_t to) {
+            range_.store(Pack(from, to));
+        }
+
+        bool PopFront(size_t& tile) {
+            uint64_t range = range_.load();
+            while (Front(range) < Back(range)) {
+                if (range_.compare_exchange_weak(range, Pack(Front(range) + 1, Back(range)))) {
+                    tile = Front(range);
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool StealBack(size_t& tile) {
+            uint64_t range = range_.load();
+            while (Front(range) < Back(range)) {
+                if (range_.compare_exchange_weak(range, Pack(Front(range), Back(range) - 1))) {
+                    tile = Back(range) - 1;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        static uint64_t Pack(uint64_t front, uint64_t back) {
+            return (front << 32) | back;
+        }
+
+        static size_t Front(uint64_t range) {
+            return range >> 32;
+        }
+
+        static size_t Back(uint64_t range) {
+            return range & 0xFFFFFFFFu;
+        }
+
+        std::atomic<uint64_t> range_{0};
+    };
+
+    size_t row_tiles_, col_tiles_;
+    std::vector<Tile> tiles_;
+    std::vector<TileDeque> deques_;
+};
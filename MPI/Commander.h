@@ -1,91 +1,100 @@
 #pragma once
 
+#include <algorithm>
 #include <iostream>
 #include <random>
-#include <fstream>
+#include <vector>
 #include <mpi.h>
 
-#include "ContigousArray.h"
+#include "BitField.h"
+#include "FieldPrinter.h"
+#include "GameOptions.h"
+#include "RunStats.h"
+#include "WorkerConfig.h"
 
 class Commander {
 public:
-    typedef ContigousArray<char> Field;
+    typedef BitField::Word Word;
 
-    Commander(const size_t height, const size_t width)
-            : nrow_{height}, ncol_{width}, field_(nrow_, ncol_) {
+    Commander(const size_t height, const size_t width, const GameOptions& options)
+            : nrow_{height}, ncol_{width}, options_(options), field_(nrow_, ncol_) {
         std::random_device rd;
         std::mt19937 gen(rd());
         std::bernoulli_distribution bern(0.5);
 
         for (size_t i = 0; i < height; ++i) {
             for (size_t j = 0; j < width; ++j) {
-                field_[i][j] = (bern(gen) ? '1' : '0');
+                field_.Set(i, j, bern(gen));
             }
         }
 
         InitiateGame();
     }
 
-    explicit Commander(const std::string& source)
-            : nrow_{GetRowCount(source)}, ncol_{GetColCount(source)}, field_(nrow_, ncol_) {
-        std::ifstream in;
-        in.open(source);
-
-        std::string line;
-        for (size_t i = 0; i < nrow_; ++i) {
-            in >> line;
-            for (size_t j = 0; j * 2 < line.size(); ++j) {
-                field_[i][j] = line[j * 2];
-            }
-        }
-
+    // The game goes on from the given generation, e.g. the one a checkpoint was taken at.
+    Commander(BitField field, const GameOptions& options, const unsigned long generation = 0)
+            : required_iter_{generation}, nrow_{field.Height()}, ncol_{field.Width()}, options_(options),
+              field_(std::move(field)) {
         InitiateGame();
     }
 
-    bool RequestStatus() {
-        unsigned long required_backup = required_iter_;
-        Stop();
-        if (required_iter_ != required_backup) {
-            Run(required_backup - required_iter_);
+    // A running game is not stopped: the workers hand in their blocks at the next generation they look for
+    // commands at and go on computing.
+    void RequestStatus(const FieldView& view) {
+        if (game_stopped_) {
+            PrintStatus(required_iter_, view);
+            return;
         }
+        SendControl('p');
+        unsigned long no_iterations = 0, generation;
+        MPI_Reduce(&no_iterations, &generation, 1, MPI_UNSIGNED_LONG, MPI_MAX, 0, control_);
+        ReceiveProgress();
+        GatherField();
+        PrintStatus(generation, view);
+    }
 
-        if (!game_stopped_) {
-            return false;
-        }
-        PrintStatus();
-        return true;
+    // Every worker reports its own counters; a running game goes on meanwhile.
+    void RequestStats() {
+        SendControl('i');
+        const size_t fields = RunStats::kGatheredFields;
+        std::vector<uint64_t> all(fields * (real_thread_count_ + 1)), none(fields);
+        MPI_Gather(none.data(), static_cast<int> (fields), MPI_UINT64_T, all.data(), static_cast<int> (fields),
+                   MPI_UINT64_T, 0, control_);
+        RunStats::Gathered(all.data() + fields, real_thread_count_).Print(std::cout);
     }
 
     void Run(const size_t iteration_count) {
         required_iter_ += iteration_count;
-        NotifyAll('r');
-        SendIterations();
+        SendControl('r');
         game_stopped_ = false;
     }
 
-    void Stop() {
-        NotifyAll('s');
-        required_iter_ = 0;
-        for (size_t i = 0; i < real_thread_count_; ++i) {
-            unsigned long cur_iter;
-            MPI_Recv(&cur_iter, 1, MPI_UNSIGNED_LONG, i + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            required_iter_ = std::max(required_iter_, cur_iter);
-        }
-        SendIterations();
-
-        size_t block_size = nrow_ / real_thread_count_;
-        size_t last_start = (real_thread_count_ - 1) * block_size;
+    // Blocks until the workers have done every generation asked for so far; for the benchmarks.
+    void Wait() {
+        SendControl('w');
+        MPI_Barrier(control_);
+    }
 
-        for (size_t i = 0; i < real_thread_count_ - 1; ++i) {
-            MPI_Recv(field_[block_size * i], block_size * ncol_, MPI_CHAR, i + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        }
-        MPI_Recv(field_[last_start], (nrow_ - last_start) * ncol_, MPI_CHAR, real_thread_count_, 0, MPI_COMM_WORLD,
-                 MPI_STATUS_IGNORE);
+    // The workers stop at the furthest generation any of them has reached, which they all learn from the same
+    // reduction; their counters are summed up on the way.
+    void Stop() {
+        SendControl('s');
+        unsigned long no_iterations = 0;
+        MPI_Allreduce(&no_iterations, &required_iter_, 1, MPI_UNSIGNED_LONG, MPI_MAX, control_);
+        ReceiveProgress();
+        GatherField();
         game_stopped_ = true;
     }
 
+    // The workers write their blocks straight into the file, at the generation they take the command at.
+    void Save(const std::string& path) {
+        SendControl('c');
+        SendPath(path);
+    }
+
     void Quit() {
-        NotifyAll('q');
+        SendControl('q');
+        MPI_Comm_free(&control_);
     }
 
 private:
@@ -94,95 +103,213 @@ private:
         MPI_Comm_size(MPI_COMM_WORLD, &world_size);
         auto thread_count = static_cast<size_t> (world_size) - 1;
 
-        real_thread_count_ = std::min(thread_count, nrow_);
-        size_t block_size = nrow_ / real_thread_count_;
-        size_t last_start = (real_thread_count_ - 1) * block_size;
-
-        NotifyAll('c');
-
-        char finalize_command = 'f';
-        for (size_t i = real_thread_count_; i < thread_count; ++i) {
-            MPI_Send(&finalize_command, 1, MPI_CHAR, i + 1, 21, MPI_COMM_WORLD);
+        ChooseGrid(thread_count);
+        real_thread_count_ = grid_rows_ * grid_cols_;
+        for (size_t r = 0; r <= grid_rows_; ++r) {
+            row_cuts_.push_back(BlockStart(r, nrow_, grid_rows_));
+        }
+        // Ghost cells come from the neighbour blocks, so the frame cannot be wider than the smallest block,
+        // nor than the single word of ghost cells a block keeps on each side.
+        size_t narrowest = ncol_;
+        for (size_t c = 0; c < grid_cols_; ++c) {
+            narrowest = std::min(narrowest, BlockCols(c));
+        }
+        unsigned long depth = std::min({options_.halo_depth, nrow_ / grid_rows_, narrowest, BitField::kWordBits});
+
+        // Workers past the grid sit this game out.
+        unsigned long players = real_thread_count_;
+        MPI_Bcast(&players, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+
+        WorkerConfig config;
+        config.field_rows = nrow_, config.field_cols = ncol_;
+        config.grid_cols = grid_cols_, config.row_cuts = row_cuts_;
+        config.depth = depth, config.generation = required_iter_, config.threads = options_.threads;
+        config.control_interval = options_.control_interval, config.gather_runs = options_.gather_runs;
+        config.rule = options_.rule, config.cycle_limit = options_.cycle_limit;
+        config.rebalance_interval = options_.rebalance_interval;
+        config.checkpoint_interval = options_.checkpoint_interval, config.checkpoint_path = options_.checkpoint_path;
+        config.trace_interval = options_.trace_interval, config.trace_path = options_.trace_path;
+        for (size_t i = 0; i < real_thread_count_; ++i) {
+            const size_t c = i % grid_cols_;
+            config.block_cols = BlockCols(c), config.word_from = BlockStart(c, field_.WordsPerRow(), grid_cols_);
+            const std::vector<char> bytes = config.Pack();
+            MPI_Send(bytes.data(), static_cast<int> (bytes.size()), MPI_BYTE, i + 1, 0, MPI_COMM_WORLD);
+
+            MPI_Datatype block = BlockType(i);
+            MPI_Send(BlockCorner(i), 1, block, i + 1, 0, MPI_COMM_WORLD);
+            MPI_Type_free(&block);
         }
 
-        for (size_t i = 0; i < real_thread_count_ - 1; ++i) {
-            int neighs[2] = {static_cast<int> (i), static_cast<int> (i + 2)};
-            if (neighs[0] == 0) {
-                neighs[0] = static_cast<int> (real_thread_count_);
-            }
-            MPI_Send(neighs, 2, MPI_INT, i + 1, 0, MPI_COMM_WORLD);
+        MPI_Group world, players_group;
+        MPI_Comm_group(MPI_COMM_WORLD, &world);
+        int range[1][3] = {{0, static_cast<int> (real_thread_count_), 1}};
+        MPI_Group_range_incl(world, 1, range, &players_group);
+        MPI_Comm_create_group(MPI_COMM_WORLD, players_group, 0, &control_);
+        MPI_Group_free(&players_group);
+        MPI_Group_free(&world);
+    }
 
-            unsigned long size[2] = {block_size, ncol_};
-            MPI_Send(size, 2, MPI_UNSIGNED_LONG, i + 1, 0, MPI_COMM_WORLD);
-            MPI_Send(field_[block_size * i], block_size * ncol_, MPI_CHAR, i + 1, 0, MPI_COMM_WORLD);
-        }
-        unsigned long size[2] = {nrow_ - last_start, ncol_};
-        int neighs[2] = {static_cast<int> (real_thread_count_ - 1), 1};
-        if (neighs[0] == 0) {
-            neighs[0] = static_cast<int> (real_thread_count_);
+    // Picks the grid of blocks that keeps as many workers busy as possible and, among those, has the shortest
+    // block border, i.e. the least halo to exchange per computed cell. Blocks are cut at word boundaries.
+    void ChooseGrid(size_t thread_count) {
+        const size_t word_count = field_.WordsPerRow();
+        size_t best_used = 0, best_border = 0;
+        for (size_t r = 1; r <= std::min(thread_count, nrow_); ++r) {
+            size_t c = std::min(thread_count / r, word_count);
+            size_t border = nrow_ / r + ncol_ / c;
+            if (r * c > best_used || (r * c == best_used && border < best_border)) {
+                grid_rows_ = r, grid_cols_ = c;
+                best_used = r * c, best_border = border;
+            }
         }
+    }
 
-        MPI_Send(neighs, 2, MPI_INT, real_thread_count_, 0, MPI_COMM_WORLD);
-        MPI_Send(size, 2, MPI_UNSIGNED_LONG, real_thread_count_, 0, MPI_COMM_WORLD);
-        MPI_Send(field_[last_start], (nrow_ - last_start) * ncol_, MPI_CHAR, real_thread_count_, 0, MPI_COMM_WORLD);
+    static size_t BlockStart(size_t index, size_t length, size_t parts) {
+        return index * length / parts;
     }
 
-    size_t GetRowCount(const std::string& source) {
-        size_t nrow = 0;
+    size_t BlockWords(size_t c) {
+        return BlockStart(c + 1, field_.WordsPerRow(), grid_cols_) - BlockStart(c, field_.WordsPerRow(), grid_cols_);
+    }
 
-        std::ifstream in;
-        in.open(source);
+    size_t BlockCols(size_t c) {
+        size_t col_from = BlockStart(c, field_.WordsPerRow(), grid_cols_) * BitField::kWordBits;
+        return std::min(ncol_, col_from + BlockWords(c) * BitField::kWordBits) - col_from;
+    }
 
-        std::string line;
-        while (in >> line) {
-            ++nrow;
-        }
-        return nrow;
+    size_t BlockRows(size_t r) {
+        return row_cuts_[r + 1] - row_cuts_[r];
     }
 
-    size_t GetColCount(const std::string& source) {
-        std::ifstream in;
-        in.open(source);
+    Word* BlockCorner(size_t worker) {
+        size_t r = worker / grid_cols_, c = worker % grid_cols_;
+        return field_.Row(row_cuts_[r]) + BlockStart(c, field_.WordsPerRow(), grid_cols_);
+    }
 
-        std::string line;
-        in >> line;
-        return (line.size() + 1) / 2;
+    // The block of the given worker as it lies in field_.
+    MPI_Datatype BlockType(size_t worker) {
+        size_t r = worker / grid_cols_, c = worker % grid_cols_;
+        MPI_Datatype block;
+        MPI_Type_vector(static_cast<int> (BlockRows(r)), static_cast<int> (BlockWords(c)),
+                        static_cast<int> (field_.WordsPerRow()), MPI_UINT64_T, &block);
+        MPI_Type_commit(&block);
+        return block;
     }
 
-    void NotifyAll(char command) {
+    void ReceiveProgress() {
+        unsigned long progress[3] = {0, 0, 0}, totals[3]; // cells computed and skipped, buffers allocated
+        MPI_Reduce(progress, totals, 3, MPI_UNSIGNED_LONG, MPI_SUM, 0, control_);
+        cells_computed_ = totals[0], cells_skipped_ = totals[1], buffer_allocations_ = totals[2];
+        unsigned long no_cycle[2] = {0, 0}, cycle[2]; // the same on every worker
+        MPI_Reduce(no_cycle, cycle, 2, MPI_UNSIGNED_LONG, MPI_MAX, 0, control_);
+        cycle_period_ = cycle[0], cycle_found_at_ = cycle[1];
+        // Where the blocks lie now, REBALANCE may have moved them; the same on every worker.
+        std::vector<unsigned long> no_cuts(row_cuts_.size(), 0);
+        MPI_Reduce(no_cuts.data(), row_cuts_.data(), static_cast<int> (row_cuts_.size()), MPI_UNSIGNED_LONG, MPI_MAX,
+                   0, control_);
+    }
+
+    void GatherField() {
         for (size_t i = 0; i < real_thread_count_; ++i) {
-            MPI_Send(&command, 1, MPI_CHAR, i + 1, 21, MPI_COMM_WORLD);
+            if (options_.gather_runs) {
+                ReceiveRuns(i);
+                continue;
+            }
+            MPI_Datatype block = BlockType(i);
+            MPI_Recv(BlockCorner(i), 1, block, i + 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            MPI_Type_free(&block);
+        }
+        // The last word of an eastmost block also carries some of its ghost cells.
+        for (size_t i = 0; i < nrow_; ++i) {
+            field_.Row(i)[field_.WordsPerRow() - 1] &= field_.LastWordMask();
         }
     }
 
-    void SendIterations() {
-        for (size_t i = 0; i < real_thread_count_; ++i) {
-            MPI_Send(&required_iter_, 1, MPI_UNSIGNED_LONG, i + 1, 0, MPI_COMM_WORLD);
+    // Receives the block of the given worker as pairs of a count of dead words and the live word after them.
+    void ReceiveRuns(size_t worker) {
+        MPI_Status status;
+        MPI_Probe(static_cast<int> (worker + 1), 0, MPI_COMM_WORLD, &status);
+        int count;
+        MPI_Get_count(&status, MPI_UINT64_T, &count);
+        std::vector<Word> runs(count);
+        MPI_Recv(runs.data(), count, MPI_UINT64_T, status.MPI_SOURCE, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+        size_t r = worker / grid_cols_, c = worker % grid_cols_;
+        size_t rows = BlockRows(r);
+        size_t words = BlockWords(c);
+        Word* corner = BlockCorner(worker);
+        for (size_t i = 0; i < rows; ++i) {
+            std::fill(corner + i * field_.WordsPerRow(), corner + i * field_.WordsPerRow() + words, 0);
+        }
+
+        size_t position = 0;
+        for (size_t k = 0; k + 1 < runs.size(); k += 2) {
+            position += runs[k];
+            corner[position / words * field_.WordsPerRow() + position % words] = runs[k + 1];
+            ++position;
         }
     }
 
-    void PrintStatus() {
-        std::cout << "Done " << required_iter_ << " iteration(s). Current field:\n";
-        PrintField();
+    // Commands and the iteration target are broadcast to all the workers at once.
+    void SendControl(char command) {
+        unsigned long control[2] = {static_cast<unsigned long> (command), required_iter_};
+        MPI_Request request;
+        MPI_Ibcast(control, 2, MPI_UNSIGNED_LONG, 0, control_, &request);
+        MPI_Wait(&request, MPI_STATUS_IGNORE);
     }
 
-    void PrintField() {
-        for (size_t i = 0; i < nrow_; ++i) {
-            for (size_t j = 0; j < ncol_; ++j) {
-                std::cout << field_[i][j];
+    void SendPath(const std::string& path) {
+        unsigned long length = path.size();
+        MPI_Bcast(&length, 1, MPI_UNSIGNED_LONG, 0, control_);
+        MPI_Bcast(const_cast<char*> (path.data()), static_cast<int> (length), MPI_CHAR, 0, control_);
+    }
+
+    void PrintStatus(unsigned long generation, const FieldView& view) {
+        if (view.raw) {
+            FieldPrinter::WriteRaw(field_, view, generation);
+            return;
+        }
+        std::cout << "Done " << generation << " iteration(s). Current field:\n";
+        FieldPrinter("0", "1").Print(field_, view);
+
+        unsigned long cells_total = cells_computed_ + cells_skipped_;
+        std::cout << "Skipped " << (cells_total == 0 ? 0.0 : 100.0 * cells_skipped_ / cells_total)
+                  << "% of cell updates.\n";
+        std::cout << "Allocated " << buffer_allocations_ << " generation buffer(s).\n";
+        if (options_.rebalance_interval > 0) {
+            std::cout << "Block rows start at row(s)";
+            for (size_t r = 0; r < grid_rows_; ++r) {
+                std::cout << ' ' << row_cuts_[r];
             }
-            std::cout << '\n';
+            std::cout << ".\n";
+        }
+        if (cycle_period_ > 0) {
+            std::cout << "Repeats with period " << cycle_period_ << " (found at generation " << cycle_found_at_
+                      << ").\n";
         }
     }
 
     unsigned long required_iter_{0};
+    unsigned long cells_computed_{0}, cells_skipped_{0};
+    unsigned long buffer_allocations_{0};
+    unsigned long cycle_period_{0}, cycle_found_at_{0};
     size_t real_thread_count_{0};
+    MPI_Comm control_;
+    size_t grid_rows_{1}, grid_cols_{1};
+    std::vector<unsigned long> row_cuts_; // first row of every block row of the grid, then nrow_
     size_t nrow_, ncol_;
     bool game_stopped_{true};
+    GameOptions options_;
 
-    Field field_;
+    BitField field_;
 };
 
+// Lets the idle workers leave their main loop.
+void EndWorkers() {
+    unsigned long players = 0;
+    MPI_Bcast(&players, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+}
+
 void QuitGame(Commander*& game, bool verbose) {
     if (!game) {
         if (verbose) {
@@ -1,123 +1,928 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include "ContigousArray.h"
+#include "BitField.h"
+#include "CycleDetector.h"
+#include "CyclicBarrier.h"
+#include "FieldFiles.h"
+#include "LifeKernel.h"
+#include "RunStats.h"
+#include "TileScheduler.h"
+#include "WorkerConfig.h"
 
 class Computer {
 public:
-    typedef ContigousArray<char> Field;
+    typedef BitField::Word Word;
 
-    explicit Computer(const int world_rank)
+    // Helper threads are only started if MPI runs at MPI_THREAD_FUNNELED at least; they never call MPI.
+    Computer(const int world_rank, const bool threads_allowed)
             : rank_(world_rank) {
-        int neighs[2];
-        MPI_Recv(&neighs, 2, MPI_INT, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        prev_ = neighs[0], next_ = neighs[1];
+        WorkerConfig config = ReceiveConfig();
+        field_rows_ = config.field_rows, field_cols_ = config.field_cols;
+        grid_cols_ = config.grid_cols, grid_row_ = (rank_ - 1) / grid_cols_;
+        row_cuts_ = config.row_cuts;
+        const size_t grid_rows = row_cuts_.size() - 1;
+        grid_size_ = static_cast<int> (grid_rows * grid_cols_);
+        row_from_ = row_cuts_[grid_row_], nrow_ = row_cuts_[grid_row_ + 1] - row_from_;
+        word_from_ = config.word_from, ncol_ = config.block_cols;
+        depth_ = config.depth, gather_runs_ = config.gather_runs;
+        control_interval_ = config.control_interval;
+        first_iter_ = done_iter_ = required_iter_ = config.generation;
+        checkpoint_interval_ = config.checkpoint_interval, checkpoint_path_ = config.checkpoint_path;
+        trace_interval_ = config.trace_interval;
+        step_row_ = life::RowStepperFor(config.rule);
+        // The hashes are taken every control_interval_ generations, which makes a period p show as
+        // lcm(p, control_interval_).
+        cycles_ = CycleDetector(config.cycle_limit * control_interval_, control_interval_);
+        rebalance_interval_ = config.rebalance_interval;
+        next_rebalance_ = first_iter_ + rebalance_interval_;
+        if (trace_interval_ > 0 && rank_ == 1) {
+            trace_.open(config.trace_path);
+            if (!trace_) {
+                std::cout << "CANNOT WRITE " << config.trace_path << '\n';
+            }
+        }
+        AllocateBuffers();
+        MPI_Datatype block_type;
+        MPI_Type_vector(static_cast<int> (nrow_), static_cast<int> (block_words_),
+                        static_cast<int> (fields_[0].WordsPerRow()), MPI_UINT64_T, &block_type);
+        MPI_Type_commit(&block_type);
+        MPI_Recv(fields_[0].Row(depth_) + 1, 1, block_type, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        MPI_Type_free(&block_type);
 
-        unsigned long size[2];
-        MPI_Recv(&size, 2, MPI_UNSIGNED_LONG, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        // The grid is only built once the block has arrived: building it waits for all the workers.
+        InitGrid(static_cast<int> (grid_rows), static_cast<int> (grid_cols_));
+        InitHaloExchange();
+        InitThreads(threads_allowed ? config.threads : 1);
+        StartMainLoop();
+    }
 
-        nrow_ = size[0], ncol_ = size[1];
-        field_ = new Field(nrow_, ncol_);
-        MPI_Recv(field_->operator[](0), nrow_ * ncol_, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    ~Computer() {
+        FinishCheckpoint();
+        MPI_Wait(&block_request_, MPI_STATUS_IGNORE);
+        phase_ = Phase::kQuit;
+        barrier_->PassThrough();
+        for (auto& thread: threads_) {
+            thread.join();
+        }
+        delete barrier_;
+        delete scheduler_;
 
-        StartMainLoop();
+        FreeHaloExchange();
+        MPI_Comm_free(&cart_);
+        MPI_Comm_free(&workers_);
+        MPI_Comm_free(&control_);
     }
 
 private:
+    static WorkerConfig ReceiveConfig() {
+        MPI_Status status;
+        MPI_Probe(0, 0, MPI_COMM_WORLD, &status);
+        int length;
+        MPI_Get_count(&status, MPI_BYTE, &length);
+        std::vector<char> bytes(length);
+        MPI_Recv(bytes.data(), length, MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        WorkerConfig config;
+        if (!config.Unpack(bytes)) {
+            std::cout << "BAD GAME CONFIG\n";
+            MPI_Abort(MPI_COMM_WORLD, 1);
+        }
+        return config;
+    }
+
+    enum class Phase {
+        kInner, // the words of an exchange generation that do not depend on the frame
+        kFrame, // the rest of an exchange generation
+        kStep,  // a whole generation between exchanges
+        kQuit
+    };
+
+    struct alignas(64) ThreadCounters {
+        unsigned long computed{0}, skipped{0};
+    };
+
+    // Commands come as broadcasts on control_. Between them the workers only look at the broadcast every
+    // control_interval_ generations; they all do it at the same generations and agree whether it has arrived,
+    // so they all handle a command at the same generation.
     void StartMainLoop() {
+        PostControl();
         while (true) {
-            int message_available = 0;
-            do {
-                MPI_Iprobe(0, 21, MPI_COMM_WORLD, &message_available, MPI_STATUS_IGNORE);
-                if (message_available) {
-                    char command;
-                    MPI_Recv(&command, 1, MPI_CHAR, 0, 21, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                    if (command == 'q') {
-                        return;
-                    } else if (command == 'r') {
-                        UpdateIterations();
-                    } else if (command == 's') {
-                        field_required = true;
-                        MPI_Send(&done_iter_, 1, MPI_UNSIGNED_LONG, 0, 0, MPI_COMM_WORLD);
-                        UpdateIterations();
-                    } else {
-                        std::cout << "UNKNOWN COMMAND " << command << " IN MAIN LOOP\n";
-                    }
+            bool command_due = required_iter_ == done_iter_;
+            if (!command_due && done_iter_ % control_interval_ == 0) {
+                uint64_t from = NowNs();
+                command_due = ControlArrived();
+                stats_.control_ns += NowNs() - from;
+            }
+            if (command_due) {
+                if (required_iter_ == done_iter_) {
+                    FinishCheckpoint(); // nothing to compute meanwhile
                 }
-
-                if (required_iter_ == done_iter_ && field_required) {
-                    field_required = false;
-                    MPI_Send(field_->operator[](0), nrow_ * ncol_, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+                MPI_Wait(&control_request_, MPI_STATUS_IGNORE);
+                uint64_t from = NowNs();
+                bool go_on = HandleControl();
+                stats_.control_ns += NowNs() - from;
+                if (!go_on) {
+                    return;
                 }
-            } while (required_iter_ == done_iter_);
-
-            std::vector<char> prev_field(ncol_), next_field(ncol_);
-            if (rank_ % 2 == 0) {
-                MPI_Send(field_->operator[](0), ncol_, MPI_CHAR, prev_, 0, MPI_COMM_WORLD);
-                MPI_Recv(&next_field[0], ncol_, MPI_CHAR, next_, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                continue;
+            }
+            const unsigned long skip_unit = cycle_period_ > 0 ? std::lcm(cycle_period_, depth_) : 0;
+            if (cycle_period_ > 0 && required_iter_ - done_iter_ >= skip_unit) {
+                // Whole periods leave the field as it is; all the workers skip the same generations, and a skip
+                // must not move the generations between halo exchanges.
+                const unsigned long skip = (required_iter_ - done_iter_) / skip_unit * skip_unit;
+                done_iter_ += skip;
+                cycle_skipped_ += skip;
+                ServeWaiters();
+                continue;
+            }
+            const bool narrowing = cycle_candidate_ > 0 && cycle_period_ == 0; // the snapshot needs the same cuts
+            if (rebalance_interval_ > 0 && done_iter_ >= next_rebalance_ && (done_iter_ - first_iter_) % depth_ == 0 &&
+                !narrowing) {
+                Rebalance(); // only right before a halo exchange, which refreshes the frame of the moved blocks
+            }
+            const uint64_t step_from = NowNs(), waits_before = stats_.wait_ns + stats_.exchange_ns;
 
-                MPI_Send(field_->operator[](nrow_ - 1), ncol_, MPI_CHAR, next_, 0, MPI_COMM_WORLD);
-                MPI_Recv(&prev_field[0], ncol_, MPI_CHAR, prev_, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+            // The block is kept with a frame of depth_ ghost cells. It is refreshed every depth_ generations,
+            // and in between the part of the frame that can still be computed exactly shrinks by one cell per
+            // generation.
+            const size_t step = (done_iter_ - first_iter_) % depth_ + 1;
+            std::vector<char>& updated_changed = row_changed_[current_ ^ 1];
+            std::fill(updated_changed.begin(), updated_changed.end(), 1);
+            if (step == 1) {
+                // Words that do not touch the frame are computed by the helpers while this thread finishes
+                // the halo exchange and then joins them.
+                StartHaloExchange();
+                RunPhase(Phase::kInner, step, [this] { FinishHaloExchange(); });
+                RunPhase(Phase::kFrame, step, [] {});
             } else {
-                if (rank_ == 1 && prev_ % 2 == 1) {
-                    MPI_Send(field_->operator[](0), ncol_, MPI_CHAR, prev_, 0, MPI_COMM_WORLD);
-                    MPI_Recv(&next_field[0], ncol_, MPI_CHAR, next_, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                RunPhase(Phase::kStep, step, [] {});
+            }
+
+            current_ ^= 1;
+            ++done_iter_;
+            const uint64_t step_ns = NowNs() - step_from;
+            running_ns_ += step_ns;
+            stats_.compute_ns += step_ns - (stats_.wait_ns + stats_.exchange_ns - waits_before);
+
+            if (narrowing) {
+                const uint64_t from = NowNs();
+                NarrowCycle();
+                stats_.control_ns += NowNs() - from;
+            }
+
+            if (checkpoint_interval_ > 0 && done_iter_ % checkpoint_interval_ == 0) {
+                StartCheckpoint(checkpoint_path_);
+            }
+            if (trace_interval_ > 0 && done_iter_ % trace_interval_ == 0) {
+                WriteTrace();
+            }
+            ServeWaiters();
+        }
+    }
+
+    // Answers the commands that wait for the generation asked for, once it is reached.
+    void ServeWaiters() {
+        if (required_iter_ == done_iter_ && field_required) {
+            field_required = false;
+            SendBlock();
+        }
+        if (required_iter_ == done_iter_ && finish_required_) {
+            finish_required_ = false;
+            MPI_Barrier(control_);
+        }
+    }
+
+    void PostControl() {
+        MPI_Ibcast(control_message_, 2, MPI_UNSIGNED_LONG, 0, control_, &control_request_);
+    }
+
+    // The workers also learn here whether all of them are done writing the checkpoint in progress and, with
+    // CYCLES, the hash of the whole field: the sum of the hashes of the blocks.
+    bool ControlArrived() {
+        const bool hashing = cycles_.Enabled() && cycle_period_ == 0 && cycle_candidate_ == 0;
+        // whether the command arrived, whether the checkpoint is unwritten, the hash of the block
+        uint64_t state[3] = {0, 0, hashing ? BlockHash() : 0}, total[3];
+        int arrived;
+        MPI_Test(&control_request_, &arrived, MPI_STATUS_IGNORE);
+        state[0] = arrived != 0;
+        if (checkpoint_pending_) {
+            int written;
+            MPI_Test(&checkpoint_request_, &written, MPI_STATUS_IGNORE);
+            state[1] = !written;
+        }
+        MPI_Allreduce(state, total, 3, MPI_UINT64_T, MPI_SUM, workers_);
+        if (checkpoint_pending_ && total[1] == 0) {
+            FinishCheckpoint();
+        }
+        if (hashing) {
+            const size_t period = cycles_.Record(done_iter_, total[2]);
+            if (period > 0) {
+                cycle_found_at_ = done_iter_;
+                if (control_interval_ == 1 || period == 1) {
+                    cycle_period_ = period;
                 } else {
-                    MPI_Recv(&next_field[0], ncol_, MPI_CHAR, next_, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                    MPI_Send(field_->operator[](0), ncol_, MPI_CHAR, prev_, 0, MPI_COMM_WORLD);
+                    cycle_candidate_ = period;
+                    cycle_snapshot_ = fields_[current_];
                 }
+            }
+        }
+        return total[0] != 0;
+    }
 
-                MPI_Recv(&prev_field[0], ncol_, MPI_CHAR, prev_, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-                MPI_Send(field_->operator[](nrow_ - 1), ncol_, MPI_CHAR, next_, 0, MPI_COMM_WORLD);
+    // The period the hashes show is a multiple of the true one, which is the smallest divisor of it after which
+    // every block is back to its snapshot; the workers agree on it a generation at a time.
+    void NarrowCycle() {
+        const unsigned long since = done_iter_ - cycle_found_at_;
+        if (since < cycle_candidate_ && cycle_candidate_ % since == 0) {
+            const uint64_t differs = SameBlock(cycle_snapshot_) ? 0 : 1;
+            uint64_t any_differs;
+            MPI_Allreduce(&differs, &any_differs, 1, MPI_UINT64_T, MPI_MAX, workers_);
+            if (any_differs == 0) {
+                cycle_period_ = since;
             }
+        }
+        if (cycle_period_ == 0 && 2 * since >= cycle_candidate_) {
+            cycle_period_ = cycle_candidate_;
+        }
+        if (cycle_period_ > 0) {
+            cycle_snapshot_ = BitField();
+        }
+    }
 
-            auto updated_field = new Field(nrow_, ncol_);
+    // Whether the cells of the block, ghost cells aside, are those of snapshot.
+    bool SameBlock(const BitField& snapshot) const {
+        const BitField& field = fields_[current_];
+        const Word last_mask = ncol_ % kBits == 0 ? ~Word{0} : (Word{1} << (ncol_ % kBits)) - 1;
+        for (size_t i = depth_; i < depth_ + nrow_; ++i) {
+            if (!std::equal(field.Row(i) + 1, field.Row(i) + block_words_, snapshot.Row(i) + 1) ||
+                ((field.Row(i)[block_words_] ^ snapshot.Row(i)[block_words_]) & last_mask) != 0) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-            for (size_t i = 0; i < nrow_; ++i) {
-                for (size_t j = 0; j < ncol_; ++j) {
-                    size_t alive_count = CountAlive(prev_field, next_field, i, j);
+    uint64_t BlockHash() const {
+        const BitField& field = fields_[current_];
+        const Word last_mask = ncol_ % kBits == 0 ? ~Word{0} : (Word{1} << (ncol_ % kBits)) - 1;
+        uint64_t hash = row_from_ * field_cols_ + word_from_ + 1;
+        for (size_t i = depth_; i < depth_ + nrow_; ++i) {
+            const Word last = field.Row(i)[block_words_] & last_mask; // the rest are ghost cells
+            hash = HashWords(field.Row(i) + 1, block_words_ - 1, hash);
+            hash = HashWords(&last, 1, hash);
+        }
+        return hash;
+    }
 
-                    if (field_->operator[](i)[j] == '1') {
-                        updated_field->operator[](i)[j] = (alive_count == 2 || alive_count == 3 ? '1' : '0');
-                    } else {
-                        updated_field->operator[](i)[j] = (alive_count == 3 ? '1' : '0');
-                    }
+    // Handles the command that has just arrived; returns false on quit.
+    bool HandleControl() {
+        const char command = static_cast<char> (control_message_[0]);
+        if (command == 'q') {
+            return false;
+        } else if (command == 'r') {
+            required_iter_ = control_message_[1];
+        } else if (command == 's') {
+            MPI_Allreduce(&done_iter_, &required_iter_, 1, MPI_UNSIGNED_LONG, MPI_MAX, control_);
+            SendProgress();
+
+            field_required = true;
+            if (required_iter_ == done_iter_) {
+                field_required = false;
+                SendBlock();
+            }
+        } else if (command == 'i') {
+            uint64_t mine[kStatsSize];
+            SaveStats(mine);
+            MPI_Gather(mine, kStatsSize, MPI_UINT64_T, nullptr, kStatsSize, MPI_UINT64_T, 0, control_);
+        } else if (command == 'w') {
+            finish_required_ = true;
+            if (required_iter_ == done_iter_) {
+                finish_required_ = false;
+                MPI_Barrier(control_);
+            }
+        } else if (command == 'p') {
+            MPI_Reduce(&done_iter_, nullptr, 1, MPI_UNSIGNED_LONG, MPI_MAX, 0, control_);
+            SendProgress();
+            SendBlock();
+        } else if (command == 'c') {
+            unsigned long length;
+            MPI_Bcast(&length, 1, MPI_UNSIGNED_LONG, 0, control_);
+            std::string path(length, ' ');
+            MPI_Bcast(path.data(), static_cast<int> (length), MPI_CHAR, 0, control_);
+            StartCheckpoint(path);
+        } else {
+            std::cout << "UNKNOWN COMMAND " << command << " IN MAIN LOOP\n";
+        }
+        PostControl();
+        return true;
+    }
+
+    void SendProgress() {
+        unsigned long progress[3] = {0, 0, buffer_allocations_};
+        for (const ThreadCounters& counters: counters_) {
+            progress[0] += counters.computed, progress[1] += counters.skipped;
+        }
+        MPI_Reduce(progress, nullptr, 3, MPI_UNSIGNED_LONG, MPI_SUM, 0, control_);
+        unsigned long cycle[2] = {cycle_period_, cycle_found_at_};
+        MPI_Reduce(cycle, nullptr, 2, MPI_UNSIGNED_LONG, MPI_MAX, 0, control_);
+        MPI_Reduce(row_cuts_.data(), nullptr, static_cast<int> (row_cuts_.size()), MPI_UNSIGNED_LONG, MPI_MAX, 0,
+                   control_);
+    }
+
+    // Moves the cuts between the block rows of the grid so that they all take about as long, judged by the compute
+    // time of the slowest block of every block row since the last time. Rows only move between vertical
+    // neighbours, and every block keeps at least depth_ rows for the frame of the next one.
+    void Rebalance() {
+        next_rebalance_ = done_iter_ + rebalance_interval_;
+        const uint64_t from = NowNs();
+        uint64_t spent = stats_.compute_ns - compute_ns_rebalanced_;
+        compute_ns_rebalanced_ = stats_.compute_ns;
+        std::vector<uint64_t> times(grid_size_);
+        MPI_Allgather(&spent, 1, MPI_UINT64_T, times.data(), 1, MPI_UINT64_T, workers_);
+
+        const size_t grid_rows = row_cuts_.size() - 1;
+        std::vector<double> row_times(grid_rows, 0.0);
+        double total = 0, slowest = 0;
+        for (size_t r = 0; r < grid_rows; ++r) {
+            for (size_t c = 0; c < grid_cols_; ++c) {
+                row_times[r] = std::max(row_times[r], static_cast<double> (times[r * grid_cols_ + c]));
+            }
+            total += row_times[r], slowest = std::max(slowest, row_times[r]);
+        }
+        if (grid_rows < 2 || slowest <= kRebalanceSlack * total / grid_rows) {
+            stats_.exchange_ns += NowNs() - from;
+            return;
+        }
+
+        // Cut k goes half way towards the row where k / grid_rows of the total time is reached, taking the time
+        // of a block row to be spread evenly over its rows. Smaller moves than min_move are not worth the new
+        // buffers.
+        const unsigned long min_move = std::max<size_t>(1, field_rows_ / grid_rows / kRebalanceSteps);
+        std::vector<unsigned long> cuts = row_cuts_;
+        size_t r = 0;
+        double above = 0; // time of the block rows above r
+        for (size_t k = 1; k < grid_rows; ++k) {
+            const double target = total * k / grid_rows;
+            while (r + 1 < grid_rows && above + row_times[r] <= target) {
+                above += row_times[r++];
+            }
+            const double rows = static_cast<double> (row_cuts_[r + 1] - row_cuts_[r]);
+            const double wanted = row_cuts_[r] + (row_times[r] > 0 ? (target - above) / row_times[r] * rows : 0);
+            const double moved = row_cuts_[k] + (std::min<double> (wanted, row_cuts_[r + 1]) - row_cuts_[k]) / 2;
+            const unsigned long low = std::max(row_cuts_[k - 1], cuts[k - 1]) + depth_;
+            const unsigned long high = row_cuts_[k + 1] - depth_;
+            cuts[k] = std::clamp(static_cast<unsigned long> (moved + 0.5), low, high);
+            if (std::max(cuts[k], row_cuts_[k]) - std::min(cuts[k], row_cuts_[k]) < min_move) {
+                cuts[k] = std::clamp(row_cuts_[k], low, high);
+            }
+        }
+        if (cuts != row_cuts_) {
+            MoveRows(cuts);
+        }
+        stats_.exchange_ns += NowNs() - from;
+    }
+
+    // Hands the rows beyond the new cuts of this block to the north and south neighbours, takes theirs and builds
+    // the buffers, the halo exchange and the bands anew for the new block.
+    void MoveRows(const std::vector<unsigned long>& cuts) {
+        const size_t old_from = row_cuts_[grid_row_], old_to = row_cuts_[grid_row_ + 1];
+        const size_t new_from = cuts[grid_row_], new_to = cuts[grid_row_ + 1];
+        const BitField& field = fields_[current_];
+        auto pack = [&](size_t from, size_t to) {
+            std::vector<Word> rows(to > from ? (to - from) * block_words_ : 0);
+            for (size_t i = from; i < to; ++i) {
+                const Word* row = field.Row(depth_ + i - old_from) + 1;
+                std::copy(row, row + block_words_, &rows[(i - from) * block_words_]);
+            }
+            return rows;
+        };
+        std::vector<Word> to_north = pack(old_from, new_from), to_south = pack(new_to, old_to);
+        std::vector<Word> from_north(old_from > new_from ? (old_from - new_from) * block_words_ : 0);
+        std::vector<Word> from_south(new_to > old_to ? (new_to - old_to) * block_words_ : 0);
+
+        // With two block rows the north and the south neighbour are the same, so the tags tell the ways apart.
+        MPI_Request requests[4];
+        int count = 0;
+        auto send = [&](std::vector<Word>& rows, int d, int tag) {
+            if (!rows.empty()) {
+                MPI_Isend(rows.data(), static_cast<int> (rows.size()), MPI_UINT64_T, neighbours_[d], tag, cart_,
+                          &requests[count++]);
+                stats_.bytes_sent += rows.size() * sizeof(Word);
+            }
+        };
+        auto receive = [&](std::vector<Word>& rows, int d, int tag) {
+            if (!rows.empty()) {
+                MPI_Irecv(rows.data(), static_cast<int> (rows.size()), MPI_UINT64_T, neighbours_[d], tag, cart_,
+                          &requests[count++]);
+                stats_.bytes_received += rows.size() * sizeof(Word);
+            }
+        };
+        send(to_north, kNorth, kRowsNorthTag);
+        send(to_south, kSouth, kRowsSouthTag);
+        receive(from_north, kNorth, kRowsSouthTag);
+        receive(from_south, kSouth, kRowsNorthTag);
+        MPI_Waitall(count, requests, MPI_STATUSES_IGNORE);
+
+        BitField moved(new_to - new_from + 2 * depth_, ncol_ + 2 * kBits);
+        for (size_t i = new_from; i < new_to; ++i) {
+            const Word* row = i < old_from ? &from_north[(i - new_from) * block_words_] :
+                              i >= old_to ? &from_south[(i - old_to) * block_words_] :
+                              field.Row(depth_ + i - old_from) + 1;
+            std::copy(row, row + block_words_, moved.Row(depth_ + i - new_from) + 1);
+        }
+
+        FreeHaloExchange();
+        nrow_ = new_to - new_from, row_from_ = new_from;
+        row_cuts_ = cuts;
+        AllocateBuffers();
+        fields_[current_] = std::move(moved);
+        InitHaloExchange();
+        delete scheduler_;
+        CutBands(counters_.size());
+    }
+
+    // The commander and the workers share control_. The workers form a periodic Cartesian grid of
+    // grid_rows x grid_cols blocks; block (r, c) belongs to the worker with world rank r * grid_cols + c + 1.
+    void InitGrid(int grid_rows, int grid_cols) {
+        MPI_Group world, players, workers;
+        MPI_Comm_group(MPI_COMM_WORLD, &world);
+        int range[1][3] = {{0, grid_rows * grid_cols, 1}};
+        MPI_Group_range_incl(world, 1, range, &players);
+        MPI_Comm_create_group(MPI_COMM_WORLD, players, 0, &control_);
+        range[0][0] = 1;
+        MPI_Group_range_incl(world, 1, range, &workers);
+        MPI_Comm_create_group(MPI_COMM_WORLD, workers, 0, &workers_);
+        MPI_Group_free(&workers);
+        MPI_Group_free(&players);
+        MPI_Group_free(&world);
+
+        int dims[2] = {grid_rows, grid_cols}, periods[2] = {1, 1};
+        MPI_Cart_create(workers_, 2, dims, periods, 0, &cart_);
+
+        int coords[2];
+        MPI_Cart_coords(cart_, rank_ - 1, 2, coords);
+        for (int d = 0; d < 8; ++d) {
+            int shifted[2] = {coords[0] + kDirections[d][0], coords[1] + kDirections[d][1]};
+            MPI_Cart_rank(cart_, shifted, &neighbours_[d]);
+        }
+    }
+
+    // Both generations live in buffers allocated once, ghost frame included; a step only swaps them.
+    // The block starts at the second word of a row: the first and the last word hold the ghost cells.
+    void AllocateBuffers() {
+        for (size_t k = 0; k < 2; ++k) {
+            fields_[k] = BitField(nrow_ + 2 * depth_, ncol_ + 2 * kBits);
+            row_changed_[k].assign(nrow_ + 2 * depth_, 1);
+            buffer_allocations_ += 2;
+        }
+        frame_changed_.assign(nrow_ + 2 * depth_, 1);
+        block_words_ = fields_[0].WordsPerRow() - 2;
+    }
+
+    void FreeHaloExchange() {
+        for (auto& requests: halo_requests_) {
+            for (auto& request: requests) {
+                MPI_Request_free(&request);
+            }
+        }
+        MPI_Type_free(&rows_type_);
+    }
+
+    // Rows of words going north and south are sent straight from the field. Ghost cells to the west and east
+    // are not word aligned in general, so these go packed one word per row, depth_ cells in each.
+    // Every buffer gets its own set of persistent requests.
+    void InitHaloExchange() {
+        MPI_Type_vector(static_cast<int> (depth_), static_cast<int> (block_words_),
+                        static_cast<int> (fields_[0].WordsPerRow()), MPI_UINT64_T, &rows_type_);
+        MPI_Type_commit(&rows_type_);
+
+        for (int d = 0; d < 8; ++d) {
+            if (kDirections[d][1] != 0) {
+                send_columns_[d].resize(kDirections[d][0] == 0 ? nrow_ : depth_);
+                recv_columns_[d].resize(send_columns_[d].size());
+            }
+        }
+        west_changed_.resize(nrow_), east_changed_.resize(nrow_);
+
+        for (size_t k = 0; k < 2; ++k) {
+            MPI_Request* requests = halo_requests_[k];
+            for (int d = 0; d < 8; ++d) {
+                const int row_side = kDirections[d][0];
+                if (kDirections[d][1] == 0) {
+                    MPI_Send_init(fields_[k].Row(row_side == 1 ? nrow_ : depth_) + 1, 1, rows_type_, neighbours_[d],
+                                  d, cart_, &requests[d]);
+                    MPI_Recv_init(fields_[k].Row(row_side == 1 ? 0 : depth_ + nrow_) + 1, 1, rows_type_,
+                                  neighbours_[7 - d], d, cart_, &requests[8 + d]);
+                    continue;
                 }
+                const int count = static_cast<int> (send_columns_[d].size());
+                MPI_Send_init(send_columns_[d].data(), count, MPI_UINT64_T, neighbours_[d], d, cart_, &requests[d]);
+                MPI_Recv_init(recv_columns_[d].data(), count, MPI_UINT64_T, neighbours_[7 - d], d, cart_,
+                              &requests[8 + d]);
             }
 
-            delete field_;
-            field_ = updated_field;
-            ++done_iter_;
+            if (k == 0) {
+                halo_bytes_ = 2 * depth_ * block_words_ * sizeof(Word) + 2 * nrow_;
+                for (int d = 0; d < 8; ++d) {
+                    halo_bytes_ += send_columns_[d].size() * sizeof(Word);
+                }
+            }
+            const int count = static_cast<int> (nrow_);
+            MPI_Send_init(&row_changed_[k][depth_], count, MPI_CHAR, neighbours_[kWest], kFlagsWestTag, cart_,
+                          &requests[16]);
+            MPI_Send_init(&row_changed_[k][depth_], count, MPI_CHAR, neighbours_[kEast], kFlagsEastTag, cart_,
+                          &requests[17]);
+            MPI_Recv_init(&west_changed_[0], count, MPI_CHAR, neighbours_[kWest], kFlagsEastTag, cart_,
+                          &requests[18]);
+            MPI_Recv_init(&east_changed_[0], count, MPI_CHAR, neighbours_[kEast], kFlagsWestTag, cart_,
+                          &requests[19]);
         }
     }
 
-    void UpdateIterations() {
-        MPI_Recv(&required_iter_, 1, MPI_UNSIGNED_LONG, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    // Every block sends its border to the 8 neighbours of the grid. The west and east neighbours also get
+    // the row change flags, since the ghost columns of a row changed if that row changed in their block.
+    void StartHaloExchange() {
+        const BitField& field = fields_[current_];
+        for (int d = 0; d < 8; ++d) {
+            const int row_side = kDirections[d][0], col_side = kDirections[d][1];
+            if (col_side == 0) {
+                continue;
+            }
+            const size_t row_from = (row_side == 1 ? nrow_ : depth_);
+            const size_t col = (col_side == 1 ? kBits + ncol_ - depth_ : kBits);
+            std::vector<Word>& columns = send_columns_[d];
+            for (size_t i = 0; i < columns.size(); ++i) {
+                columns[i] = life::ReadBits(field.Row(row_from + i), field.Width(), col, depth_);
+            }
+        }
+        MPI_Startall(20, halo_requests_[current_]);
+        stats_.bytes_sent += halo_bytes_, stats_.bytes_received += halo_bytes_;
     }
 
-    size_t CountAlive(const std::vector<char>& prev_field, const std::vector<char>& next_field, size_t i, size_t j) {
-        size_t count = 0;
-        for (int vshift = -1; vshift < 2; ++vshift) {
-            for (int hshift = -1; hshift < 2; ++hshift) {
-                size_t hind = (j + hshift + ncol_) % ncol_;
+    void FinishHaloExchange() {
+        const uint64_t from = NowNs();
+        MPI_Waitall(20, halo_requests_[current_], MPI_STATUSES_IGNORE);
+        stats_.exchange_ns += NowNs() - from;
 
-                if (i == 0 && vshift == -1) {
-                    count += static_cast<int> (prev_field[hind] == '1');
-                } else if (i == nrow_ - 1 && vshift == 1) {
-                    count += static_cast<int> (next_field[hind] == '1');
-                } else {
-                    count += static_cast<int> (field_->operator[](i + vshift)[hind] == '1');
+        // The ghost columns go in after the ghost rows: the last word of a ghost row may carry stale corner cells.
+        BitField& field = fields_[current_];
+        for (int d = 0; d < 8; ++d) {
+            const int row_side = kDirections[d][0], col_side = kDirections[d][1];
+            if (col_side == 0) {
+                continue;
+            }
+            const size_t row_from = (row_side == 1 ? 0 : row_side == 0 ? depth_ : depth_ + nrow_);
+            const size_t col = (col_side == 1 ? kBits - depth_ : kBits + ncol_);
+            const std::vector<Word>& columns = recv_columns_[d];
+            for (size_t i = 0; i < columns.size(); ++i) {
+                life::WriteBits(field.Row(row_from + i), col, columns[i], depth_);
+            }
+        }
+
+        // The helpers are still reading row_changed_ for the inner words, so the frame gets its own flags.
+        const std::vector<char>& row_changed = row_changed_[current_];
+        for (size_t i = 0; i < depth_; ++i) {
+            frame_changed_[i] = frame_changed_[depth_ + nrow_ + i] = 1;
+        }
+        for (size_t i = 0; i < nrow_; ++i) {
+            frame_changed_[depth_ + i] = row_changed[depth_ + i] || west_changed_[i] || east_changed_[i];
+        }
+    }
+
+    // The rows of the block are cut into bands that the threads take from the scheduler, stealing from
+    // each other once their own share is done.
+    void InitThreads(size_t thread_count) {
+        if (thread_count == 0) {
+            thread_count = std::max(1u, std::thread::hardware_concurrency());
+        }
+        CutBands(thread_count);
+        thread_count = std::min(thread_count, scheduler_->TileCount());
+        scheduler_->SetWorkerCount(thread_count);
+        counters_ = std::vector<ThreadCounters>(thread_count);
+
+        barrier_ = new tpcc::solutions::CyclicBarrier{thread_count};
+        for (size_t i = 1; i < thread_count; ++i) {
+            threads_.emplace_back(&Computer::HelperCycle, this, i);
+        }
+    }
+
+    void CutBands(size_t thread_count) {
+        const size_t rows = nrow_ + 2 * depth_, words = fields_[0].WordsPerRow();
+        scheduler_ = new TileScheduler{rows, words, std::max<size_t>(1, rows / (4 * thread_count)), words};
+        scheduler_->SetWorkerCount(thread_count);
+    }
+
+    void HelperCycle(const size_t worker) {
+        while (true) {
+            barrier_->PassThrough();
+            if (phase_ == Phase::kQuit) {
+                return;
+            }
+            ProcessBands(worker);
+            barrier_->PassThrough();
+        }
+    }
+
+    // Lets the helpers work through a phase; this thread runs before_work first and then joins them.
+    template<typename BeforeWork>
+    void RunPhase(Phase phase, size_t step, BeforeWork&& before_work) {
+        phase_ = phase, step_ = step;
+        scheduler_->Refill();
+        uint64_t from = NowNs();
+        barrier_->PassThrough();
+        stats_.wait_ns += NowNs() - from;
+        before_work();
+        ProcessBands(0);
+        from = NowNs();
+        barrier_->PassThrough();
+        stats_.wait_ns += NowNs() - from;
+    }
+
+    void ProcessBands(const size_t worker) {
+        size_t band;
+        while (scheduler_->Next(worker, band)) {
+            const TileScheduler::Tile& tile = scheduler_->GetTile(band);
+            for (size_t i = tile.row_from; i < tile.row_to; ++i) {
+                ProcessRow(worker, i);
+            }
+        }
+    }
+
+    void ProcessRow(const size_t worker, const size_t i) {
+        const size_t rows = nrow_ + 2 * depth_, words = fields_[0].WordsPerRow();
+        const bool inner = nrow_ > 2 && block_words_ > 3 && depth_ < i && i + 1 < depth_ + nrow_;
+        if (phase_ == Phase::kInner) {
+            if (inner) {
+                ComputeRow(worker, i, 2, block_words_ - 1, row_changed_[current_]);
+            }
+            return;
+        }
+        if (i < step_ || i + step_ >= rows) {
+            return;
+        }
+
+        if (phase_ == Phase::kFrame && inner) {
+            ComputeRow(worker, i, 0, 2, frame_changed_);
+            ComputeRow(worker, i, block_words_ - 1, words, frame_changed_);
+        } else {
+            ComputeRow(worker, i, 0, words, phase_ == Phase::kFrame ? frame_changed_ : row_changed_[current_]);
+        }
+
+        const size_t valid_from = kBits - depth_ + step_, valid_to = kBits + ncol_ + depth_ - step_;
+        row_changed_[current_ ^ 1][i] = BitsDiffer(fields_[current_].Row(i), fields_[current_ ^ 1].Row(i),
+                                                   valid_from, valid_to);
+    }
+
+    // Computes words [w_from, w_to) of row i of the next generation unless neither the row nor its neighbour
+    // rows changed last generation according to row_changed.
+    void ComputeRow(const size_t worker, size_t i, size_t w_from, size_t w_to, const std::vector<char>& row_changed) {
+        const BitField& field = fields_[current_];
+        BitField& updated_field = fields_[current_ ^ 1];
+        bool active = row_changed[i - 1] || row_changed[i] || row_changed[i + 1];
+        if (!active) {
+            std::copy(field.Row(i) + w_from, field.Row(i) + w_to, updated_field.Row(i) + w_from);
+            counters_[worker].skipped += (w_to - w_from) * kBits;
+            return;
+        }
+
+        step_row_(field.Row(i - 1), field.Row(i), field.Row(i + 1), updated_field.Row(i), field.Width(),
+                  w_from, w_to, false);
+        counters_[worker].computed += (w_to - w_from) * kBits;
+    }
+
+    // Whether cells [from, to) of the two rows differ.
+    static bool BitsDiffer(const Word* a, const Word* b, size_t from, size_t to) {
+        Word differ = 0;
+        for (size_t w = from / kBits; w * kBits < to; ++w) {
+            Word mask = ~Word{0};
+            if (w == from / kBits) {
+                mask &= ~Word{0} << (from % kBits);
+            }
+            if ((w + 1) * kBits > to) {
+                mask &= (Word{1} << (to % kBits)) - 1;
+            }
+            differ |= (a[w] ^ b[w]) & mask;
+        }
+        return differ != 0;
+    }
+
+    // The block goes to the commander either as it is or, for mostly dead blocks, as pairs of a count of dead
+    // words and the live word after them. It is copied aside first and sent while the game goes on, so
+    // STATUS does not hold up a running game; the copy is kept for the next time.
+    void SendBlock() {
+        MPI_Wait(&block_request_, MPI_STATUS_IGNORE);
+        const BitField& field = fields_[current_];
+        if (!gather_runs_) {
+            outgoing_block_.resize(nrow_ * block_words_);
+            for (size_t i = 0; i < nrow_; ++i) {
+                std::copy(field.Row(depth_ + i) + 1, field.Row(depth_ + i) + 1 + block_words_,
+                          &outgoing_block_[i * block_words_]);
+            }
+        } else {
+            outgoing_block_.clear();
+            Word dead_words = 0;
+            for (size_t i = depth_; i < depth_ + nrow_; ++i) {
+                for (size_t w = 1; w <= block_words_; ++w) {
+                    if (field.Row(i)[w] == 0) {
+                        ++dead_words;
+                        continue;
+                    }
+                    outgoing_block_.push_back(dead_words);
+                    outgoing_block_.push_back(field.Row(i)[w]);
+                    dead_words = 0;
                 }
             }
         }
-        return count - static_cast<int> (field_->operator[](i)[j] == '1');
+        MPI_Isend(outgoing_block_.data(), static_cast<int> (outgoing_block_.size()), MPI_UINT64_T, 0, 0,
+                  MPI_COMM_WORLD, &block_request_);
+        stats_.bytes_sent += outgoing_block_.size() * sizeof(Word);
     }
 
+    // Generations since START, running time and the counters of stats_, as gathered for STATS and TRACE.
+    void SaveStats(uint64_t* to) const {
+        to[0] = done_iter_ - first_iter_ - cycle_skipped_, to[1] = running_ns_;
+        stats_.Save(to + 2);
+    }
+
+    // The first worker gathers the counters of all of them and appends them to the trace file.
+    void WriteTrace() {
+        uint64_t mine[kStatsSize];
+        SaveStats(mine);
+        std::vector<uint64_t> all(rank_ == 1 ? kStatsSize * grid_size_ : 0);
+        MPI_Gather(mine, kStatsSize, MPI_UINT64_T, all.data(), kStatsSize, MPI_UINT64_T, 0, workers_);
+        if (rank_ == 1) {
+            RunStats::Gathered(all.data(), grid_size_).PrintJson(trace_);
+            trace_.flush();
+        }
+    }
+
+    // All the workers copy their block aside and start writing it at the same generation, into its place in a
+    // binary field file; the commander is not involved. The file is named path + ".part" until every block is
+    // in, then renamed. A checkpoint still being written when the next one starts is waited for.
+    void StartCheckpoint(const std::string& path) {
+        FinishCheckpoint();
+        checkpoint_snapshot_.resize(nrow_ * block_words_);
+        const BitField& field = fields_[current_];
+        const Word last_mask = ncol_ % kBits == 0 ? ~Word{0} : (Word{1} << (ncol_ % kBits)) - 1;
+        for (size_t i = 0; i < nrow_; ++i) {
+            Word* row = &checkpoint_snapshot_[i * block_words_];
+            std::copy(field.Row(depth_ + i) + 1, field.Row(depth_ + i) + 1 + block_words_, row);
+            row[block_words_ - 1] &= last_mask; // ghost cells of an eastmost block
+        }
+
+        checkpoint_path_written_ = path;
+        const std::string part = path + ".part";
+        if (MPI_File_open(workers_, part.c_str(), MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL,
+                          &checkpoint_file_) != MPI_SUCCESS) {
+            if (rank_ == 1) {
+                std::cout << "CANNOT WRITE " << path << '\n';
+            }
+            return;
+        }
+        const size_t field_words = (field_cols_ + kBits - 1) / kBits;
+        MPI_File_set_size(checkpoint_file_, field_files::kBinaryHeader + field_rows_ * field_words * sizeof(Word));
+        if (rank_ == 1) {
+            char header[field_files::kBinaryHeader];
+            uint64_t sides[3] = {field_rows_, field_cols_, done_iter_};
+            std::copy(field_files::kBinaryMagic, field_files::kBinaryMagic + sizeof(field_files::kBinaryMagic), header);
+            std::memcpy(header + sizeof(field_files::kBinaryMagic), sides, sizeof(sides));
+            MPI_File_write_at(checkpoint_file_, 0, header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE);
+        }
+
+        int sizes[2] = {static_cast<int> (field_rows_), static_cast<int> (field_words)};
+        int subsizes[2] = {static_cast<int> (nrow_), static_cast<int> (block_words_)};
+        int starts[2] = {static_cast<int> (row_from_), static_cast<int> (word_from_)};
+        MPI_Datatype block_in_file;
+        MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, MPI_UINT64_T, &block_in_file);
+        MPI_Type_commit(&block_in_file);
+        MPI_File_set_view(checkpoint_file_, field_files::kBinaryHeader, MPI_UINT64_T, block_in_file, "native",
+                          MPI_INFO_NULL);
+        MPI_Type_free(&block_in_file);
+        MPI_File_iwrite(checkpoint_file_, checkpoint_snapshot_.data(), static_cast<int> (checkpoint_snapshot_.size()),
+                        MPI_UINT64_T, &checkpoint_request_);
+        checkpoint_pending_ = true;
+    }
+
+    // Collective over the workers, like StartCheckpoint.
+    void FinishCheckpoint() {
+        if (!checkpoint_pending_) {
+            return;
+        }
+        MPI_Wait(&checkpoint_request_, MPI_STATUS_IGNORE);
+        MPI_File_close(&checkpoint_file_);
+        MPI_Barrier(workers_);
+        if (rank_ == 1) {
+            std::rename((checkpoint_path_written_ + ".part").c_str(), checkpoint_path_written_.c_str());
+        }
+        checkpoint_pending_ = false;
+    }
+
+    static constexpr size_t kBits = BitField::kWordBits;
+    static constexpr int kStatsSize = RunStats::kGatheredFields;
+    // Directions of the grid as (row, column) shifts; direction 7 - d is the opposite of direction d.
+    static constexpr int kDirections[8][2] = {{-1, -1}, {-1, 0}, {-1, 1}, {0, -1},
+                                              {0, 1}, {1, -1}, {1, 0}, {1, 1}};
+    static const int kNorth = 1, kWest = 3, kEast = 4, kSouth = 6;
+    static const int kFlagsWestTag = 8, kFlagsEastTag = 9, kRowsNorthTag = 10, kRowsSouthTag = 11;
+    static constexpr double kRebalanceSlack = 1.1; // block rows are left as they are up to this over the mean
+    static constexpr size_t kRebalanceSteps = 32;  // a cut moves by at least 1 / kRebalanceSteps of a block row
+
     bool field_required{false};
+    bool finish_required_{false}; // the commander waits for the workers to reach required_iter_
+    bool gather_runs_{false};
+    std::vector<Word> outgoing_block_; // the block as it was last sent to the commander
+    MPI_Request block_request_{MPI_REQUEST_NULL};
+
+    MPI_Comm control_, workers_, cart_;
+    MPI_Request control_request_;
+    unsigned long control_message_[2]; // command and iteration target
+    size_t control_interval_{1};
+
+    int neighbours_[8];
+    MPI_Datatype rows_type_;
+    MPI_Request halo_requests_[2][20]; // persistent halo exchange of either buffer
+    std::vector<Word> send_columns_[8], recv_columns_[8]; // packed ghost columns, by direction of travel
+    std::vector<char> west_changed_, east_changed_;       // row change flags of the west and east neighbours
+
+    unsigned long buffer_allocations_{0}; // heap buffers of generation size ever allocated; only REBALANCE adds any
+                                          // once running
 
     size_t nrow_{0}, ncol_{0};
+    size_t field_rows_{0}, field_cols_{0}; // the whole field
+    size_t row_from_{0}, word_from_{0};    // where the block lies in it
+    size_t grid_cols_{1}, grid_row_{0};    // of the grid of blocks, and the block row of this block
+    std::vector<unsigned long> row_cuts_;  // first row of every block row, then field_rows_
+    size_t rebalance_interval_{0};         // generations between rebalancings, 0 for none
+    unsigned long next_rebalance_{0};
+    uint64_t compute_ns_rebalanced_{0};    // stats_.compute_ns at the last rebalancing
+    size_t block_words_{0}; // words holding cells of the block in every row
+    size_t depth_{1};       // width of the ghost frame, i.e. generations between halo exchanges
     unsigned long required_iter_{0}, done_iter_{0};
-    int rank_, prev_{0}, next_{0};
-    Field* field_ = nullptr;
-};
\ No newline at end of file
+    unsigned long first_iter_{0}; // generation the game started at; halo exchanges are counted from it
+    int rank_;
+
+    life::RowStepper step_row_{nullptr}; // the kernel of the rule of the game
+
+    CycleDetector cycles_;
+    unsigned long cycle_candidate_{0}; // a multiple of the period, while it is narrowed down
+    BitField cycle_snapshot_;          // the block at cycle_found_at_, meanwhile
+    unsigned long cycle_period_{0};    // 0 until the field is found to repeat, then generations are skipped
+    unsigned long cycle_found_at_{0};
+    unsigned long cycle_skipped_{0};   // generations skipped in whole periods
+
+    WorkerStats stats_;        // of this process; the helper threads are only seen through the barrier waits
+    uint64_t running_ns_{0};   // time spent on the generations done, waits for commands excluded
+    uint64_t halo_bytes_{0};   // sent, and received, by every halo exchange
+    size_t trace_interval_{0}; // generations between trace lines, 0 for none
+    std::ofstream trace_;      // written by the first worker only
+    int grid_size_{1};
+
+    size_t checkpoint_interval_{0}; // generations between automatic checkpoints, 0 for none
+    std::string checkpoint_path_;
+    std::string checkpoint_path_written_;
+    std::vector<Word> checkpoint_snapshot_; // the block as it goes to the file, kept for the next checkpoint
+    MPI_File checkpoint_file_;
+    MPI_Request checkpoint_request_;
+    bool checkpoint_pending_{false};
+
+    BitField fields_[2];
+    std::vector<char> row_changed_[2]; // whether each row, ghost rows included, changed in the last generation
+    size_t current_{0};                // buffer holding the current generation
+    std::vector<char> frame_changed_;  // row_changed_ of the current buffer, updated with the fresh frame
+
+    std::vector<std::thread> threads_;
+    std::vector<ThreadCounters> counters_;
+    tpcc::solutions::CyclicBarrier* barrier_{nullptr};
+    TileScheduler* scheduler_{nullptr};
+    Phase phase_{Phase::kStep}; // written by this thread while the helpers wait at the barrier
+    size_t step_{1};
+};
+
+constexpr size_t Computer::kBits;
+constexpr int Computer::kStatsSize;
+constexpr int Computer::kDirections[8][2];
+
+// Takes part in the games the commander starts until the program ends.
+void ServeGames(const int world_rank, const bool threads_allowed) {
+    while (true) {
+        unsigned long players; // workers taking part in the next game, none once the program ends
+        MPI_Bcast(&players, 1, MPI_UNSIGNED_LONG, 0, MPI_COMM_WORLD);
+        if (players == 0) {
+            return;
+        }
+
+        if (static_cast<unsigned long> (world_rank) <= players) {
+            Computer computer(world_rank, threads_allowed);
+        }
+    }
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "LifeRule.h"
+
+// What the commander tells a worker about the game it joins. It travels as a single message of bytes; Fields
+// lists the members once for both packing and unpacking, so a new setting is one more member and one more name
+// there.
+struct WorkerConfig {
+    unsigned long field_rows{0}, field_cols{0};  // the whole field
+    unsigned long grid_cols{1};                  // of the grid of blocks
+    std::vector<unsigned long> row_cuts;         // first row of every block row of the grid, then field_rows
+    unsigned long block_cols{0}, word_from{0};   // the columns of this worker's block
+    unsigned long depth{1};                      // width of the ghost frame
+    unsigned long generation{0};                 // the game goes on from it
+    unsigned long threads{0};
+    unsigned long control_interval{1};
+    bool gather_runs{false};
+    life::Rule rule{life::kConwayRule};
+    unsigned long cycle_limit{0};
+    unsigned long rebalance_interval{0};
+    unsigned long checkpoint_interval{0};
+    std::string checkpoint_path;
+    unsigned long trace_interval{0};
+    std::string trace_path;
+
+    template<typename Config, typename Visit>
+    static void Fields(Config& c, Visit&& visit) {
+        visit(c.field_rows), visit(c.field_cols), visit(c.grid_cols), visit(c.row_cuts), visit(c.block_cols);
+        visit(c.word_from), visit(c.depth), visit(c.generation), visit(c.threads), visit(c.control_interval);
+        visit(c.gather_runs), visit(c.rule), visit(c.cycle_limit), visit(c.rebalance_interval);
+        visit(c.checkpoint_interval), visit(c.checkpoint_path), visit(c.trace_interval), visit(c.trace_path);
+    }
+
+    std::vector<char> Pack() const {
+        std::vector<char> bytes;
+        auto put = [&bytes](const void* data, size_t size) {
+            bytes.insert(bytes.end(), static_cast<const char*> (data), static_cast<const char*> (data) + size);
+        };
+        Fields(*this, [&put](auto& field) {
+            typedef std::remove_reference_t<decltype(field)> Field;
+            if constexpr (std::is_trivially_copyable_v<Field>) {
+                put(&field, sizeof(field));
+            } else {
+                const unsigned long count = field.size();
+                put(&count, sizeof(count));
+                put(field.data(), count * sizeof(field[0]));
+            }
+        });
+        return bytes;
+    }
+
+    // Returns false if bytes are not a whole config.
+    bool Unpack(const std::vector<char>& bytes) {
+        size_t at = 0;
+        bool ok = true;
+        auto get = [&](void* data, size_t size) {
+            ok = ok && size <= bytes.size() - at;
+            if (ok) {
+                std::memcpy(data, bytes.data() + at, size);
+                at += size;
+            }
+        };
+        Fields(*this, [&](auto& field) {
+            typedef std::remove_reference_t<decltype(field)> Field;
+            if constexpr (std::is_trivially_copyable_v<Field>) {
+                get(&field, sizeof(field));
+            } else {
+                unsigned long count = 0;
+                get(&count, sizeof(count));
+                ok = ok && count <= (bytes.size() - at) / sizeof(field[0]);
+                if (ok) {
+                    field.resize(count);
+                    get(field.data(), count * sizeof(field[0]));
+                }
+            }
+        });
+        return ok && at == bytes.size();
+    }
+};
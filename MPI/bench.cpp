@@ -0,0 +1,110 @@
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BenchReport.h"
+#include "Commander.h"
+#include "Computer.h"
+
+// Headless benchmark of the MPI engine on seeded fields, run with mpirun -np N (see bin/bench.sh). Prints one JSON
+// object per line from the commander. Usage: MPIGameOfLifeBench [generations] [max_threads]
+
+namespace {
+
+const double kDensities[] = {0.05, 0.35, 0.5};
+const uint64_t kSeed = 20240601;
+
+// Per-generation latency is the time of a batch of CONTROL generations, from RUN until every worker is done,
+// spread over the batch. The last batch is cut short so that exactly generations are run and sampled.
+bench::Latencies RunGame(const BitField& field, const GameOptions& options, size_t generations) {
+    Commander game(field, options);
+    game.Run(options.control_interval); // warm up
+    game.Wait();
+
+    bench::Latencies latencies;
+    for (size_t g = 0; g < generations; g += options.control_interval) {
+        const size_t batch = std::min(options.control_interval, generations - g);
+        auto start = bench::Clock::now();
+        game.Run(batch);
+        game.Wait();
+        double seconds = bench::SecondsSince(start);
+        for (size_t s = 0; s < batch; ++s) {
+            latencies.Add(seconds / batch);
+        }
+    }
+    game.Quit();
+    return latencies;
+}
+
+// Strong scaling over the threads of every worker keeps the field; weak scaling over the processes, which
+// takes one run per process count, gives every worker a share of share x share cells.
+void BenchScaling(size_t processes, const std::vector<size_t>& thread_counts, double density, size_t generations) {
+    const size_t side = 4096, share = 1024;
+    BitField field = bench::SeededField(side, side, density, kSeed);
+    double base = 0;
+    for (size_t threads: thread_counts) {
+        GameOptions options;
+        options.threads = threads;
+        bench::Latencies latencies = RunGame(field, options, generations);
+        double rate = static_cast<double> (side) * side * generations / latencies.Total();
+        base = base == 0 ? rate : base;
+        bench::JsonLine("mpi_strong_scaling").Add("height", side).Add("width", side).Add("density", density)
+                .Add("processes", processes).Add("threads", threads).Add("generations", generations)
+                .AddRun(side, side, latencies, generations).Add("speedup", rate / base)
+                .Add("efficiency", rate / base / threads).Print();
+    }
+
+    GameOptions options;
+    options.threads = 1;
+    BitField weak_field = bench::SeededField(share * processes, share, density, kSeed);
+    bench::Latencies latencies = RunGame(weak_field, options, generations);
+    bench::JsonLine("mpi_weak_scaling").Add("height", share * processes).Add("width", share)
+            .Add("density", density).Add("processes", processes).Add("threads", size_t{1})
+            .Add("generations", generations).AddRun(share * processes, share, latencies, generations).Print();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+    int world_rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    if (world_rank != 0) {
+        ServeGames(world_rank, thread_support >= MPI_THREAD_FUNNELED);
+        MPI_Finalize();
+        return 0;
+    }
+
+    size_t generations = argc > 1 ? std::stoul(argv[1]) : 64;
+    size_t max_threads = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+    const size_t processes = world_size - 1;
+
+    for (size_t side: {1024, 4096}) {
+        for (double density: kDensities) {
+            GameOptions options;
+            options.threads = 1;
+            bench::Latencies latencies = RunGame(bench::SeededField(side, side, density, kSeed), options,
+                                                 generations);
+            bench::JsonLine("mpi_engine").Add("height", side).Add("width", side).Add("density", density)
+                    .Add("processes", processes).Add("threads", size_t{1}).Add("generations", generations)
+                    .AddRun(side, side, latencies, generations).Print();
+        }
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    for (double density: kDensities) {
+        BenchScaling(processes, thread_counts, density, generations);
+    }
+
+    EndWorkers();
+    MPI_Finalize();
+    return 0;
+}
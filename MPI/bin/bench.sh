@@ -0,0 +1,5 @@
+#!/bin/bash
+# Local benchmark over 1..$1 workers (plus the commander), JSON lines on stdout: ./bench.sh 4 [generations] [max_threads]
+for workers in $(seq 1 $1); do
+    /usr/lib64/openmpi/bin/mpirun -np $((workers + 1)) --bind-to none ./MPIGameOfLifeBench $2 $3
+done
@@ -1,2 +1,2 @@
 #!/bin/bash
-salloc -N $1 /usr/lib64/openmpi/bin/mpirun --map-by ppr:1:node ./MPIGameOfLife
+salloc -N $1 /usr/lib64/openmpi/bin/mpirun --map-by ppr:1:node --bind-to none ./MPIGameOfLife
@@ -1,21 +1,17 @@
 #include "Commander.h"
 #include "Computer.h"
+#include "FieldFiles.h"
 
 int main() {
-    MPI_Init(NULL, NULL);
+    // Only the main thread of a worker talks to MPI, its helper threads just compute.
+    int thread_support;
+    MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &thread_support);
 
     int world_rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
 
     if (world_rank != 0) {
-        while (true) {
-            char command;
-            MPI_Recv(&command, 1, MPI_CHAR, 0, 21, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-            if (command != 'f') {
-                Computer computer(world_rank);
-            }
-        }
+        ServeGames(world_rank, thread_support >= MPI_THREAD_FUNNELED);
     } else {
         Commander* game = nullptr;
 
@@ -23,23 +19,38 @@ int main() {
             std::string query;
             std::cin >> query;
 
-            if (query == "START") {
+            if (query == "START" || query == "LOAD") { // LOAD resumes at the generation recorded in the file
                 std::string source;
                 std::cin >> source;
 
+                size_t height = 0, width = 0;
+                if (source == "RANDOM") {
+                    std::cin >> height >> width;
+                }
+
+                GameOptions options;
+                std::string bad_key;
+                if (!ReadGameOptions(std::cin, options, bad_key)) {
+                    std::cout << "BAD START OPTION " << bad_key << '\n';
+                    continue;
+                }
+
                 if (game) {
                     std::cout << "THE GAME HAS ALREADY STARTED\n";
                     continue;
                 }
 
                 if (source == "RANDOM") {
-                    size_t height, width;
-                    std::cin >> height >> width;
-
-                    game = new Commander(height, width);
-                } else {
-                    game = new Commander(source);
+                    game = new Commander(height, width, options);
+                    continue;
                 }
+                BitField field;
+                uint64_t generation;
+                if (!ReadFieldFile(source, field, generation)) {
+                    std::cout << "CANNOT READ " << source << '\n';
+                    continue;
+                }
+                game = new Commander(std::move(field), options, query == "LOAD" ? generation : 0);
                 continue;
             }
             if (query == "STATUS") {
@@ -47,9 +58,20 @@ int main() {
                     std::cout << "START THE GAME FIRSTLY\n";
                     continue;
                 }
-                if (!game->RequestStatus()) {
-                    std::cout << "STOP THE GAME FIRSTLY\n";
+                FieldView view;
+                if (!ReadFieldView(std::cin, view)) {
+                    std::cout << "BAD STATUS VIEW\n";
+                    continue;
+                }
+                game->RequestStatus(view);
+                continue;
+            }
+            if (query == "STATS") {
+                if (!game) {
+                    std::cout << "START THE GAME FIRSTLY\n";
+                    continue;
                 }
+                game->RequestStats();
                 continue;
             }
             if (query == "RUN") {
@@ -71,12 +93,23 @@ int main() {
                 game->Stop();
                 continue;
             }
+            if (query == "SAVE") {
+                std::string path;
+                std::cin >> path;
+                if (!game) {
+                    std::cout << "START THE GAME FIRSTLY\n";
+                    continue;
+                }
+                game->Save(path);
+                continue;
+            }
             if (query == "QUIT") {
                 QuitGame(game, true);
                 continue;
             }
             if (query == "END") {
                 QuitGame(game, false);
+                EndWorkers();
                 break;
             }
             std::cout << "UNKNOWN COMMAND\n";
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// The CPUs the process may run on, as narrowed by taskset or numactl; empty where this cannot be asked.
+inline std::vector<size_t> AllowedCpus() {
+    std::vector<size_t> cpus;
+#if defined(__linux__)
+    cpu_set_t set;
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (size_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+#endif
+    return cpus;
+}
+
+inline bool IsAllowedCpu(const std::vector<size_t>& allowed, size_t cpu) {
+    return std::find(allowed.begin(), allowed.end(), cpu) != allowed.end();
+}
+
+// Keeps the calling thread on cpu from now on; returns false if it cannot.
+inline bool PinThisThread(size_t cpu) {
+#if defined(__linux__)
+    if (cpu >= CPU_SETSIZE) {
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
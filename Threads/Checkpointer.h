@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "BitField.h"
+#include "FieldFiles.h"
+
+// Writes snapshots of a game to binary field files in a background thread, one at a time. The snapshot buffer is
+// kept between checkpoints, so a snapshot of the same size as the last one does not allocate.
+class Checkpointer {
+public:
+    ~Checkpointer() {
+        Wait();
+    }
+
+    // Makes the snapshot buffer available, waiting for the write in progress if wait is set; returns false if
+    // the buffer is still being written.
+    bool Acquire(bool wait) {
+        if (busy_.load() && !wait) {
+            return false;
+        }
+        Wait();
+        return true;
+    }
+
+    BitField& Snapshot() {
+        return snapshot_;
+    }
+
+    // Starts writing the snapshot, which must have been acquired and filled.
+    void Start(size_t generation, const std::string& path) {
+        busy_.store(true);
+        writer_ = std::thread([this, generation, path] {
+            if (!WriteBinaryField(path, snapshot_, generation)) {
+                std::cout << "CANNOT WRITE " << path << '\n';
+            }
+            busy_.store(false);
+        });
+    }
+
+    void Wait() {
+        if (writer_.joinable()) {
+            writer_.join();
+        }
+    }
+
+private:
+    BitField snapshot_;
+    std::thread writer_;
+    std::atomic<bool> busy_{false};
+};
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "BitField.h"
+#include "FieldIO.h"
+#include "LifeKernel.h"
+
+// What BATCH reports about one board.
+struct BoardResult {
+    uint64_t seed{0};
+    size_t population{0}; // after the last generation
+    size_t period{0};     // 0 if the board was not seen repeating
+};
+
+// Many independent toroidal boards of the same size stepped in lockstep. The boards are sliced the other way
+// round than a BitField: a slice holds one cell of every board of the batch, a bit per board, so a generation of
+// the whole batch is one NextCells per cell and the neighbours are whole slices, with no shifts at all.
+class Ensemble {
+public:
+#if defined(__GNUC__)
+    typedef life::WordVector Slice;
+    static constexpr size_t kSliceWords = life::kVectorWords;
+#else
+    typedef life::Word Slice;
+    static constexpr size_t kSliceWords = 1;
+#endif
+    static constexpr size_t kBoards = kSliceWords * BitField::kWordBits; // boards in a batch
+
+    Ensemble(size_t height, size_t width, const life::Rule& rule = life::kConwayRule)
+            : height_{height}, width_{width}, cur_(height * width), next_(height * width),
+              snapshot_(height * width) {
+        life::VisitRule(rule, [this](auto fixed) { step_ = &StepSlices<decltype(fixed)>; });
+    }
+
+    // Runs the RandomField boards of seeds [first_seed, first_seed + count), count <= kBoards, for generations.
+    // Periods are found the way of Brent's algorithm: every board is compared with a snapshot taken at the last
+    // power of two generations, and the first match after it is exactly the period. Once every board has
+    // repeated, the rest of the generations are skipped by whole periods.
+    void RunBatch(uint64_t first_seed, size_t count, size_t generations, BoardResult* results) {
+        Load(first_seed, count);
+        Mask active{}, found{};
+        for (size_t k = 0; k < count; ++k) {
+            active[k / BitField::kWordBits] |= life::Word{1} << (k % BitField::kWordBits);
+            results[k] = BoardResult{first_seed + k, 0, 0};
+        }
+
+        std::copy(cur_.begin(), cur_.end(), snapshot_.begin());
+        size_t done = 0, snapshot_generation = 0;
+        while (done < generations && found != active) {
+            Mask differs = ToMask(step_(cur_.data(), next_.data(), snapshot_.data(), height_, width_));
+            std::swap(cur_, next_);
+            ++done;
+            for (size_t w = 0; w < kSliceWords; ++w) {
+                for (life::Word repeated = active[w] & ~found[w] & ~differs[w]; repeated != 0;
+                     repeated &= repeated - 1) {
+                    results[w * BitField::kWordBits + __builtin_ctzll(repeated)].period = done - snapshot_generation;
+                }
+                found[w] |= active[w] & ~differs[w];
+            }
+            if ((done & (done - 1)) == 0) {
+                std::copy(cur_.begin(), cur_.end(), snapshot_.begin());
+                snapshot_generation = done;
+            }
+        }
+        if (found != active) {
+            CountPopulation(active, results);
+            return;
+        }
+
+        // Board k now ends where it is (generations - done) % period generations from here.
+        size_t remaining = generations - done, last_offset = 0;
+        for (size_t k = 0; k < count; ++k) {
+            last_offset = std::max(last_offset, remaining % results[k].period);
+        }
+        for (size_t offset = 0;; ++offset) {
+            Mask due{};
+            for (size_t k = 0; k < count; ++k) {
+                if (remaining % results[k].period == offset) {
+                    due[k / BitField::kWordBits] |= life::Word{1} << (k % BitField::kWordBits);
+                }
+            }
+            CountPopulation(due, results);
+            if (offset == last_offset) {
+                break;
+            }
+            step_(cur_.data(), next_.data(), snapshot_.data(), height_, width_);
+            std::swap(cur_, next_);
+        }
+    }
+
+private:
+    typedef std::array<life::Word, kSliceWords> Mask; // a bit per board
+    typedef Slice (*SliceStepper)(const Slice* cur, Slice* next, const Slice* snapshot, size_t height, size_t width);
+
+    // The next generation of every board; returns the boards that differ from snapshot afterwards.
+    template<typename R>
+    static Slice StepSlices(const Slice* cur, Slice* next, const Slice* snapshot, size_t height, size_t width) {
+        Slice differs{};
+        for (size_t i = 0; i < height; ++i) {
+            const Slice* up = cur + (i == 0 ? height - 1 : i - 1) * width;
+            const Slice* mid = cur + i * width;
+            const Slice* down = cur + (i + 1 == height ? 0 : i + 1) * width;
+            Slice* out = next + i * width;
+            const Slice* before = snapshot + i * width;
+            auto step = [&](size_t w, size_t j, size_t e) {
+                out[j] = life::NextCells<R>(up[w], up[j], up[e], mid[w], mid[j], mid[e], down[w], down[j], down[e]);
+                differs |= out[j] ^ before[j];
+            };
+            step(width - 1, 0, width > 1 ? 1 : 0);
+            for (size_t j = 1; j + 1 < width; ++j) {
+                step(j - 1, j, j + 1);
+            }
+            if (width > 1) {
+                step(width - 2, width - 1, 0);
+            }
+        }
+        return differs;
+    }
+
+    static Mask ToMask(const Slice& slice) {
+        Mask mask;
+        std::memcpy(mask.data(), &slice, sizeof(slice));
+        return mask;
+    }
+
+    static const life::Word* Words(const Slice& slice) {
+        return reinterpret_cast<const life::Word*> (&slice);
+    }
+
+    static life::Word* Words(Slice& slice) {
+        return reinterpret_cast<life::Word*> (&slice);
+    }
+
+    void Load(uint64_t first_seed, size_t count) {
+        std::fill(cur_.begin(), cur_.end(), Slice{});
+        for (size_t k = 0; k < count; ++k) {
+            const BitField board = RandomField(height_, width_, first_seed + k);
+            const life::Word bit = life::Word{1} << (k % BitField::kWordBits);
+            for (size_t i = 0; i < height_; ++i) {
+                const BitField::Word* row = board.Row(i);
+                for (size_t w = 0; w < board.WordsPerRow(); ++w) {
+                    for (BitField::Word bits = row[w]; bits != 0; bits &= bits - 1) {
+                        const size_t j = w * BitField::kWordBits + __builtin_ctzll(bits);
+                        Words(cur_[i * width_ + j])[k / BitField::kWordBits] |= bit;
+                    }
+                }
+            }
+        }
+    }
+
+    // Sets the population of the boards in mask.
+    void CountPopulation(const Mask& mask, BoardResult* results) const {
+        for (const Slice& cell: cur_) {
+            for (size_t w = 0; w < kSliceWords; ++w) {
+                for (life::Word alive = Words(cell)[w] & mask[w]; alive != 0; alive &= alive - 1) {
+                    ++results[w * BitField::kWordBits + __builtin_ctzll(alive)].population;
+                }
+            }
+        }
+    }
+
+    size_t height_, width_;
+    SliceStepper step_{nullptr};
+    std::vector<Slice> cur_, next_, snapshot_; // cell i * width + j of every board
+};
+
+// Runs the RandomField boards of seeds [first_seed, first_seed + boards) in batches of Ensemble::kBoards, which
+// thread_count threads take one at a time.
+inline std::vector<BoardResult> RunEnsemble(size_t thread_count, size_t boards, size_t height, size_t width,
+                                            uint64_t first_seed, size_t generations, const life::Rule& rule) {
+    std::vector<BoardResult> results(boards);
+    const size_t batches = (boards + Ensemble::kBoards - 1) / Ensemble::kBoards;
+    std::atomic<size_t> next_batch{0};
+    auto work = [&]() {
+        Ensemble ensemble(height, width, rule);
+        for (size_t batch; (batch = next_batch.fetch_add(1)) < batches;) {
+            const size_t from = batch * Ensemble::kBoards;
+            ensemble.RunBatch(first_seed + from, std::min(Ensemble::kBoards, boards - from), generations,
+                              results.data() + from);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < std::min(thread_count, batches); ++t) {
+        threads.emplace_back(work);
+    }
+    work();
+    for (std::thread& thread: threads) {
+        thread.join();
+    }
+    return results;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+
+#include "BitField.h"
+#include "FieldPrinter.h"
+
+// The same seed gives the same field.
+inline BitField RandomField(const size_t height, const size_t width, const uint64_t seed) {
+    BitField field(height, width);
+
+    std::mt19937_64 gen(seed); // every bit of a word is alive with probability 1/2
+
+    for (size_t i = 0; i < height; ++i) {
+        BitField::Word* row = field.Row(i);
+        for (size_t w = 0; w < field.WordsPerRow(); ++w) {
+            row[w] = gen();
+        }
+        row[field.WordsPerRow() - 1] &= field.LastWordMask();
+    }
+    return field;
+}
+
+inline BitField RandomField(const size_t height, const size_t width) {
+    std::random_device rd;
+    return RandomField(height, width, rd());
+}
+
+inline void PrintField(const BitField& field, const FieldView& view = FieldView{}) {
+    FieldPrinter("\u2B1C", "\u2B1B").Print(field, view);
+}
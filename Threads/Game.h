@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+#include "FieldPrinter.h"
+
+// Command surface shared by the engines a game can be started with.
+class Game {
+public:
+    virtual ~Game() = default;
+
+    // Prints the given view of the latest complete generation; a running game is not held up meanwhile.
+    virtual void RequestStatus(const FieldView& view) = 0;
+
+    // Prints where the time of the game went so far, see RunStats.h.
+    virtual void RequestStats() = 0;
+
+    virtual void Run(size_t iteration_count) = 0;
+
+    virtual void Stop() = 0;
+
+    virtual void Quit() = 0;
+
+    // Writes the current generation to a binary field file in the background, the game goes on meanwhile.
+    virtual void Save(const std::string& path) = 0;
+};
@@ -0,0 +1,452 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "Affinity.h"
+#include "BitField.h"
+#include "Checkpointer.h"
+#include "CycleDetector.h"
+#include "CyclicBarrier.h"
+#include "FieldIO.h"
+#include "Game.h"
+#include "GameOptions.h"
+#include "LifeKernel.h"
+#include "RunStats.h"
+#include "TileScheduler.h"
+
+class GameOfLife : public Game {
+public:
+    typedef BitField Field;
+
+    GameOfLife(const size_t thread_count, Field start_field, const GameOptions& options, const size_t generation = 0)
+            : required_iter_{generation}, done_iter_{generation}, first_iter_{generation}, options_(options) {
+        // The workers copy the start field in themselves, see FirstTouch.
+        fields_[0] = Field::Untouched(start_field.Height(), start_field.Width());
+        fields_[1] = Field::Untouched(start_field.Height(), start_field.Width());
+        start_field_ = std::move(start_field);
+
+        InitiateGame(thread_count, options);
+
+        std::unique_lock lock{change_iterations_};
+        field_ready_.wait(lock, [this] { return touched_; });
+    }
+
+    ~GameOfLife() override {
+        delete barrier_;
+        delete scheduler_;
+    }
+
+    // The current field is only read by the workers until PublishGeneration flips it, which cannot happen while
+    // the lock is held, so it is copied while they go on with the next one and printed once they may flip it.
+    void RequestStatus(const FieldView& view) override {
+        size_t generation;
+        {
+            std::lock_guard lock{change_iterations_};
+            status_field_ = GetCurrentField();
+            generation = done_iter_.load();
+        }
+        PrintStatus(status_field_, generation, view);
+    }
+
+    void RequestStats() override {
+        std::lock_guard lock{change_iterations_};
+        CollectStats().Print(std::cout);
+    }
+
+    // For the benchmarks, which have no STATUS to wait for the game with.
+    size_t DoneIterations() const {
+        return done_iter_.load();
+    }
+
+    void Run(const size_t iteration_count) override {
+        std::lock_guard lock{change_iterations_};
+
+        required_iter_.fetch_add(iteration_count);
+        can_iterate_.notify_one();
+    }
+
+    void Stop() override {
+        std::lock_guard lock{change_iterations_};
+        required_iter_.store(done_iter_);
+    }
+
+    void Quit() override {
+        Stop();
+        {
+            std::lock_guard lock{change_iterations_};
+
+            quit_ = true;
+            can_iterate_.notify_one();
+        }
+
+        for (auto& thread: threads_) {
+            thread.join();
+        }
+        checkpointer_.Wait();
+    }
+
+    // Copies the current field without stopping the workers, as RequestStatus does.
+    void Save(const std::string& path) override {
+        std::lock_guard lock{change_iterations_};
+        checkpointer_.Acquire(true);
+        checkpointer_.Snapshot() = GetCurrentField();
+        checkpointer_.Start(done_iter_.load(), path);
+    }
+
+private:
+    void InitiateGame(const size_t thread_count, const GameOptions& options) {
+        const Field& field = GetCurrentField();
+        size_t tile_words = (options.tile_cols + Field::kWordBits - 1) / Field::kWordBits;
+        scheduler_ = new TileScheduler{field.Height(), field.WordsPerRow(), options.tile_rows, tile_words};
+
+        size_t real_thread_count = std::min(thread_count, scheduler_->TileCount());
+        scheduler_->SetWorkerCount(real_thread_count);
+
+        // A tile is only exact for as many generations as its margin is deep, and its stillness only carries
+        // over to the next block of generations if no change can cross a whole neighbour tile meanwhile.
+        block_depth_ = std::min(options.halo_depth, Field::kWordBits);
+        for (size_t i = 0; i < scheduler_->TileCount(); ++i) {
+            const TileScheduler::Tile& tile = scheduler_->GetTile(i);
+            size_t tile_cols = std::min(tile.w_to * Field::kWordBits, field.Width()) - tile.w_from * Field::kWordBits;
+            block_depth_ = std::min({block_depth_, tile.row_to - tile.row_from, tile_cols});
+        }
+        scratches_ = std::vector<life::TileScratch>(real_thread_count);
+        step_tile_ = life::TileStepperFor(options.rule);
+
+        // Nothing is known about the generation before the first one, so every tile starts active.
+        changes_[0].assign(scheduler_->TileCount(), 1);
+        changes_[1].assign(scheduler_->TileCount(), 1);
+        tile_counters_ = std::vector<TileCounters>(real_thread_count);
+
+        // The hashes are taken once per block, which makes a period p show as lcm(p, block_depth_).
+        cycles_ = CycleDetector(options.cycle_limit * block_depth_, block_depth_);
+        if (cycles_.Enabled()) {
+            tile_hashes_.resize(scheduler_->TileCount());
+        }
+
+        barrier_ = new tpcc::solutions::CyclicBarrier{real_thread_count};
+
+        if (options.trace_interval > 0) {
+            trace_.open(options.trace_path);
+            if (!trace_) {
+                std::cout << "CANNOT WRITE " << options.trace_path << '\n';
+            }
+        }
+
+        // Worker i goes to the i-th CPU of the list, round and round.
+        if (options.pin_threads) {
+            const std::vector<size_t> allowed = AllowedCpus();
+            worker_cpus_ = options.affinity.empty() ? allowed : options.affinity;
+            for (size_t cpu: worker_cpus_) {
+                if (!IsAllowedCpu(allowed, cpu)) {
+                    std::cout << "CANNOT PIN TO CPU " << cpu << '\n';
+                    worker_cpus_.clear();
+                    break;
+                }
+            }
+        }
+
+        for (size_t i = 0; i < real_thread_count; ++i) {
+            threads_.emplace_back(&GameOfLife::ThreadCycle, this, i);
+        }
+    }
+
+    // Linux places a page on the NUMA node of the thread that first writes it, so every worker writes the rows of
+    // its own share of tiles in both fields itself: only the rows around the shares and the stolen tiles are then
+    // read across nodes.
+    void FirstTouch(size_t worker) {
+        TileCounters& counters = tile_counters_[worker];
+        size_t from, to;
+        scheduler_->GetShare(worker, from, to);
+        for (size_t tile = from; tile < to; ++tile) {
+            const TileScheduler::Tile& piece = scheduler_->GetTile(tile);
+            for (size_t i = piece.row_from; i < piece.row_to; ++i) {
+                std::copy(start_field_.Row(i) + piece.w_from, start_field_.Row(i) + piece.w_to,
+                          fields_[0].Row(i) + piece.w_from);
+                std::fill(fields_[1].Row(i) + piece.w_from, fields_[1].Row(i) + piece.w_to, 0);
+            }
+            if (cycles_.Enabled()) {
+                tile_hashes_[tile] = TileHash(fields_[0], tile);
+                counters.hash_delta ^= tile_hashes_[tile];
+            }
+        }
+    }
+
+    void ThreadCycle(size_t worker) {
+        if (!worker_cpus_.empty()) {
+            PinThisThread(worker_cpus_[worker % worker_cpus_.size()]);
+        }
+        FirstTouch(worker);
+
+        TileCounters& counters = tile_counters_[worker];
+        while (true) {
+            // The time the barrier spends waiting for RUN is not the threads waiting for each other.
+            uint64_t arrived = NowNs();
+            barrier_->PassThrough([this] { PublishGeneration(); });
+            uint64_t left = NowNs();
+            counters.wait_ns.fetch_add(left - arrived - std::min(left - arrived, last_idle_ns_),
+                                       std::memory_order_relaxed);
+
+            if (finished_) {
+                return;
+            }
+
+            const std::vector<uint8_t>& changes = GetCurrentChanges();
+            std::vector<uint8_t>& next_changes = GetNextChanges();
+
+            size_t tile;
+            while (scheduler_->Next(worker, tile)) {
+                if (IsActive(changes, tile)) {
+                    next_changes[tile] = ComputePiece(scheduler_->GetTile(tile), scratches_[worker]);
+                    counters.computed.fetch_add(1, std::memory_order_relaxed);
+                    if (next_changes[tile] && cycles_.Enabled() && cycle_period_ == 0) {
+                        const uint64_t hash = TileHash(GetNextField(), tile);
+                        counters.hash_delta ^= tile_hashes_[tile] ^ hash;
+                        tile_hashes_[tile] = hash;
+                    }
+                } else {
+                    // Neither the tile nor its surroundings changed last block, so it does not change now,
+                    // and the next field already holds it: it was equal to the current one a block ago.
+                    next_changes[tile] = 0;
+                    counters.skipped.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+            counters.compute_ns.fetch_add(NowNs() - left, std::memory_order_relaxed);
+        }
+    }
+
+    // Runs in the last thread to reach the barrier while the others are parked in it: publishes the block of
+    // generations just computed and waits until there is more to compute.
+    void PublishGeneration() {
+        std::unique_lock lock{change_iterations_};
+        if (!touched_) { // the workers are through FirstTouch
+            touched_ = true;
+            start_field_ = Field();
+            field_ready_.notify_one();
+        }
+        if (step_ > 0) {
+            running_ns_ += NowNs() - block_start_ns_;
+            current_ ^= 1;
+            done_iter_.fetch_add(step_);
+            if (required_iter_.load() < done_iter_.load()) { // stopped while the block was computed
+                required_iter_.store(done_iter_);
+            }
+
+            if (verbose_) {
+                PrintStatus(GetCurrentField(), done_iter_.load());
+            }
+            // A checkpoint that comes due while the previous one is still being written is skipped.
+            size_t interval = options_.checkpoint_interval;
+            if (interval > 0 && done_iter_.load() / interval != (done_iter_.load() - step_) / interval &&
+                checkpointer_.Acquire(false)) {
+                checkpointer_.Snapshot() = GetCurrentField();
+                checkpointer_.Start(done_iter_.load(), options_.checkpoint_path);
+            }
+            interval = options_.trace_interval;
+            if (interval > 0 && done_iter_.load() / interval != (done_iter_.load() - step_) / interval) {
+                CollectStats().PrintJson(trace_);
+            }
+            if (cycles_.Enabled() && cycle_period_ == 0) {
+                for (auto& counters: tile_counters_) {
+                    field_hash_ ^= counters.hash_delta;
+                    counters.hash_delta = 0;
+                }
+                if (cycle_candidate_ == 0) {
+                    RecordHash();
+                } else {
+                    NarrowCycle();
+                }
+            }
+        }
+
+        uint64_t idle_from = NowNs();
+        while (true) {
+            can_iterate_.wait(lock, [this] { return required_iter_.load() > done_iter_.load() || quit_; });
+            if (cycle_period_ == 0 || quit_) {
+                break;
+            }
+            // Whole periods leave the field as it is; skipping whole blocks too keeps the blocks where they are.
+            const size_t skip_unit = std::lcm(cycle_period_, block_depth_);
+            const size_t skip = (required_iter_.load() - done_iter_.load()) / skip_unit * skip_unit;
+            done_iter_.fetch_add(skip);
+            cycle_skipped_ += skip;
+            if (required_iter_.load() > done_iter_.load()) {
+                break;
+            }
+        }
+        block_start_ns_ = NowNs();
+        last_idle_ns_ = block_start_ns_ - idle_from;
+
+        if (done_iter_.load() == required_iter_.load()) {
+            finished_ = true;
+            return;
+        }
+        const bool narrowing = cycle_candidate_ > 0 && cycle_period_ == 0;
+        step_ = std::min(narrowing ? size_t{1} : block_depth_, required_iter_.load() - done_iter_.load());
+        scheduler_->Refill();
+    }
+
+    void RecordHash() {
+        const size_t period = cycles_.Record(done_iter_.load(), field_hash_);
+        if (period == 0) {
+            return;
+        }
+        cycle_found_at_ = done_iter_.load();
+        if (block_depth_ == 1 || period == 1) {
+            cycle_period_ = period;
+            return;
+        }
+        cycle_candidate_ = period;
+        cycle_snapshot_ = GetCurrentField();
+    }
+
+    // The period the hashes show is a multiple of the true one, which is the smallest divisor of it after which
+    // the field is back to the snapshot; the blocks are cut to single generations until it is known.
+    void NarrowCycle() {
+        const size_t since = done_iter_.load() - cycle_found_at_;
+        if (since < cycle_candidate_ && cycle_candidate_ % since == 0 && GetCurrentField() == cycle_snapshot_) {
+            cycle_period_ = since;
+        } else if (2 * since >= cycle_candidate_) {
+            cycle_period_ = cycle_candidate_;
+        }
+        if (cycle_period_ > 0) {
+            cycle_snapshot_ = Field();
+        }
+    }
+
+    bool IsActive(const std::vector<uint8_t>& changes, size_t tile) const {
+        for (int row_shift = -1; row_shift < 2; ++row_shift) {
+            for (int col_shift = -1; col_shift < 2; ++col_shift) {
+                if (changes[scheduler_->Neighbour(tile, row_shift, col_shift)]) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    bool ComputePiece(const TileScheduler::Tile& tile, life::TileScratch& scratch) { // returns if anything changed
+        const Field& cur_field = GetCurrentField();
+        Field& next_field = GetNextField();
+
+        return step_tile_(cur_field, next_field, tile.row_from, tile.row_to, tile.w_from, tile.w_to, step_, scratch);
+    }
+
+    uint64_t TileHash(const Field& field, size_t tile_index) const {
+        const TileScheduler::Tile& tile = scheduler_->GetTile(tile_index);
+        uint64_t hash = tile_index + 1;
+        for (size_t i = tile.row_from; i < tile.row_to; ++i) {
+            hash = HashWords(field.Row(i) + tile.w_from, tile.w_to - tile.w_from, hash);
+        }
+        return hash;
+    }
+
+    // Runs under change_iterations_, so that the generations match the running time.
+    RunStats CollectStats() const {
+        RunStats stats;
+        stats.generations = done_iter_.load() - first_iter_ - cycle_skipped_;
+        stats.seconds = running_ns_ / 1e9;
+        stats.parks = barrier_->ParkCount();
+        for (const auto& counters: tile_counters_) {
+            WorkerStats worker;
+            worker.compute_ns = counters.compute_ns.load(std::memory_order_relaxed);
+            worker.wait_ns = counters.wait_ns.load(std::memory_order_relaxed);
+            stats.workers.push_back(worker);
+        }
+        return stats;
+    }
+
+    void PrintStatus(const Field& field, size_t generation, const FieldView& view = FieldView{}) {
+        if (view.raw) {
+            FieldPrinter::WriteRaw(field, view, generation);
+            return;
+        }
+        std::cout << "Done " << generation << " iteration(s). Current field:\n";
+        PrintField(field, view);
+
+        uint64_t computed = 0, skipped = 0;
+        for (const auto& counters: tile_counters_) {
+            computed += counters.computed.load(std::memory_order_relaxed);
+            skipped += counters.skipped.load(std::memory_order_relaxed);
+        }
+        std::cout << "Skipped " << (computed + skipped == 0 ? 0.0 : 100.0 * skipped / (computed + skipped))
+                  << "% of tile updates.\n";
+        if (cycle_period_ > 0) {
+            std::cout << "Repeats with period " << cycle_period_ << " (found at generation " << cycle_found_at_
+                      << ").\n";
+        }
+    }
+
+    Field& GetCurrentField() {
+        return fields_[current_];
+    }
+
+    Field& GetNextField() {
+        return fields_[1 - current_];
+    }
+
+    std::vector<uint8_t>& GetCurrentChanges() {
+        return changes_[current_];
+    }
+
+    std::vector<uint8_t>& GetNextChanges() {
+        return changes_[1 - current_];
+    }
+
+    struct alignas(64) TileCounters {
+        std::atomic<uint64_t> computed{0}, skipped{0};
+        std::atomic<uint64_t> compute_ns{0}, wait_ns{0}; // each written by its own thread only
+        uint64_t hash_delta{0}; // tile hashes changed in this block, only read across the barrier
+    };
+
+    std::vector<std::thread> threads_;
+    std::vector<Field> fields_{2};
+    Field start_field_; // until the workers have copied it into fields_[0]
+    Field status_field_; // copy of the generation STATUS prints, kept for the next STATUS
+    std::vector<uint8_t> changes_[2]; // per tile: whether it changed on the way to the generation in fields_[i]
+    std::vector<TileCounters> tile_counters_;
+    std::vector<life::TileScratch> scratches_;
+    std::vector<size_t> worker_cpus_; // empty for workers left to the OS
+    life::TileStepper step_tile_{nullptr}; // the kernel of the rule of the game
+    size_t current_{0};               // index of the current field, flipped once per block of generations
+    size_t block_depth_{1};           // generations computed per tile visit
+    size_t step_{0};                  // generations in the block being computed
+
+    std::mutex change_iterations_;
+    std::condition_variable can_iterate_;
+    std::condition_variable field_ready_;
+    tpcc::solutions::CyclicBarrier* barrier_{nullptr};
+    TileScheduler* scheduler_{nullptr};
+
+    std::atomic<size_t> required_iter_{0}, done_iter_{0};
+    size_t first_iter_{0};       // generation the game started at
+    uint64_t running_ns_{0};     // time spent on the blocks of generations done, waits for RUN excluded
+    uint64_t block_start_ns_{0}; // when the block being computed started
+    uint64_t last_idle_ns_{0};   // how long the last PublishGeneration waited for RUN
+    std::ofstream trace_;
+
+    CycleDetector cycles_;
+    std::vector<uint64_t> tile_hashes_; // of the current field, with CYCLES only
+    uint64_t field_hash_{0};            // all of them combined
+    size_t cycle_candidate_{0};         // a multiple of the period, while it is narrowed down
+    Field cycle_snapshot_;              // the field at cycle_found_at_, meanwhile
+    size_t cycle_period_{0};            // 0 until the field is found to repeat, then generations are skipped
+    size_t cycle_found_at_{0};
+    size_t cycle_skipped_{0};           // generations skipped in whole periods
+
+    GameOptions options_;
+    Checkpointer checkpointer_;
+    bool verbose_{false}; // for debug purposes, non accessible from outside
+    bool quit_{false};
+    bool touched_{false};  // set once the workers have copied the start field
+    bool finished_{false}; // written only by PublishGeneration, so all threads see the same value
+};
@@ -0,0 +1,350 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BitField.h"
+#include "LifeKernel.h"
+
+// Gosper's HashLife on a hash-consed quadtree. Every distinct square of cells is stored once and remembers its
+// centre advanced by 2^j generations, so content repeating in space or time is only ever computed once.
+// The toroidal board is kept as one period of a periodic tiling of the plane, which is why both of its sides
+// have to be powers of two.
+class HashLife {
+public:
+    typedef uint32_t NodeId;
+
+    static constexpr unsigned kMaxLogStep = 60;
+
+    explicit HashLife(const size_t cache_nodes, const life::Rule& rule = life::kConwayRule)
+            : cache_nodes_{cache_nodes}, collect_at_{cache_nodes}, block_table_(rule), buckets_(1 << 10, kNone) {
+        nodes_.push_back(Node{{kNone, kNone, kNone, kNone}, kNone, kNone, 0, -1, false}); // dead cell
+        nodes_.push_back(Node{{kNone, kNone, kNone, kNone}, kNone, kNone, 0, -1, false}); // alive cell
+        live_count_ = 2;
+
+        empty_.push_back(0);
+        for (unsigned level = 1; level <= kMaxLogStep + 2; ++level) {
+            NodeId e = empty_.back();
+            empty_.push_back(Join(e, e, e, e));
+        }
+    }
+
+    HashLife(const HashLife&) = delete;
+
+    HashLife(HashLife&&) = delete;
+
+    static bool FitsTorus(const size_t height, const size_t width) {
+        auto power_of_two = [](size_t x) { return x > 0 && (x & (x - 1)) == 0; };
+        return power_of_two(height) && power_of_two(width);
+    }
+
+    void SetTorus(const BitField& field) {
+        height_ = field.Height(), width_ = field.Width();
+        torus_level_ = 0;
+        while ((size_t{1} << torus_level_) < std::max(height_, width_)) {
+            ++torus_level_;
+        }
+        torus_ = Build(field, torus_level_, 0, 0);
+    }
+
+    BitField GetTorus() const {
+        BitField field(height_, width_);
+        Fill(field, torus_, torus_level_, 0, 0);
+        return field;
+    }
+
+    NodeId Root() const {
+        return torus_;
+    }
+
+    void SetRoot(NodeId root) {
+        torus_ = root;
+    }
+
+    size_t NodeCount() const {
+        return live_count_;
+    }
+
+    // Advances the torus by 2^log_step generations, log_step <= kMaxLogStep. Garbage is also collected in the
+    // middle of the step whenever the cache outgrows its bound, keeping the nodes the step still works on.
+    void StepTorus(const unsigned log_step) {
+        // A square of 2^level cells covers the period, and its centre advanced by 2^log_step generations
+        // is again one period of the tiling, just shifted.
+        const unsigned level = std::max(torus_level_ + 1, log_step + 2);
+
+        NodeId tiling = torus_;
+        for (unsigned l = torus_level_; l < level; ++l) {
+            tiling = Join(tiling, tiling, tiling, tiling);
+        }
+        NodeId centre = Result(tiling, log_step);
+
+        if (level - 2 >= torus_level_) {
+            // The centre starts at a multiple of the period: its north-west corner is the torus itself.
+            for (unsigned l = level - 1; l > torus_level_; --l) {
+                centre = nodes_[centre].child[kNw];
+            }
+            torus_ = centre;
+        } else {
+            // The centre is shifted by half a period both ways: swap its quadrants diagonally.
+            const Node& c = nodes_[centre];
+            torus_ = Join(c.child[kSe], c.child[kSw], c.child[kNe], c.child[kNw]);
+        }
+    }
+
+    // Once the cache outgrows its bound, frees every node unreachable from the torus and forgets results
+    // pointing to freed nodes.
+    void CollectGarbage() {
+        collect_at_ = cache_nodes_;
+        if (live_count_ > cache_nodes_) {
+            Collect();
+        }
+    }
+
+private:
+    static constexpr NodeId kNone = UINT32_MAX;
+    static constexpr size_t kNw = 0, kNe = 1, kSw = 2, kSe = 3;
+
+    struct Node {
+        NodeId child[4];
+        NodeId result;      // centre advanced by 2^result_step generations
+        NodeId next;        // next node in the hash bucket or in the free list
+        uint8_t level;
+        int8_t result_step; // -1 if no result is memoized
+        bool mark;
+    };
+
+    // Frees every node unreachable from the torus or from roots_.
+    void Collect() {
+        for (Node& node: nodes_) {
+            node.mark = false;
+        }
+        nodes_[0].mark = nodes_[1].mark = true;
+        Mark(torus_);
+        for (NodeId e: empty_) {
+            Mark(e);
+        }
+        for (NodeId root: roots_) {
+            Mark(root);
+        }
+
+        std::fill(buckets_.begin(), buckets_.end(), kNone);
+        free_ = kNone;
+        live_count_ = 2;
+        for (NodeId id = static_cast<NodeId> (nodes_.size()) - 1; id >= 2; --id) {
+            Node& node = nodes_[id];
+            if (!node.mark) {
+                node.result_step = -1;
+                node.next = free_;
+                free_ = id;
+                continue;
+            }
+
+            if (node.result_step >= 0 && !nodes_[node.result].mark) {
+                node.result_step = -1;
+            }
+            size_t bucket = Hash(node.child[kNw], node.child[kNe], node.child[kSw], node.child[kSe]) &
+                            (buckets_.size() - 1);
+            node.next = buckets_[bucket];
+            buckets_[bucket] = id;
+            ++live_count_;
+        }
+    }
+
+    static size_t Hash(NodeId nw, NodeId ne, NodeId sw, NodeId se) {
+        uint64_t hash = nw;
+        hash = hash * 0x9E3779B97F4A7C15ull + ne;
+        hash = hash * 0x9E3779B97F4A7C15ull + sw;
+        hash = hash * 0x9E3779B97F4A7C15ull + se;
+        return static_cast<size_t> (hash ^ (hash >> 29));
+    }
+
+    NodeId Join(NodeId nw, NodeId ne, NodeId sw, NodeId se) {
+        size_t bucket = Hash(nw, ne, sw, se) & (buckets_.size() - 1);
+        for (NodeId id = buckets_[bucket]; id != kNone; id = nodes_[id].next) {
+            const Node& node = nodes_[id];
+            if (node.child[kNw] == nw && node.child[kNe] == ne && node.child[kSw] == sw && node.child[kSe] == se) {
+                return id;
+            }
+        }
+
+        Node node{{nw, ne, sw, se}, kNone, buckets_[bucket],
+                  static_cast<uint8_t> (nodes_[nw].level + 1), -1, false};
+        NodeId id;
+        if (free_ != kNone) {
+            id = free_;
+            free_ = nodes_[id].next;
+            nodes_[id] = node;
+        } else {
+            id = static_cast<NodeId> (nodes_.size());
+            nodes_.push_back(node);
+        }
+        buckets_[bucket] = id;
+
+        if (++live_count_ > buckets_.size()) {
+            Rehash();
+        }
+        return id;
+    }
+
+    void Rehash() {
+        std::vector<NodeId> buckets(buckets_.size() * 2, kNone);
+        for (NodeId head: buckets_) {
+            for (NodeId id = head; id != kNone;) {
+                Node& node = nodes_[id];
+                NodeId next = node.next;
+                size_t bucket = Hash(node.child[kNw], node.child[kNe], node.child[kSw], node.child[kSe]) &
+                                (buckets.size() - 1);
+                node.next = buckets[bucket];
+                buckets[bucket] = id;
+                id = next;
+            }
+        }
+        buckets_.swap(buckets);
+    }
+
+    void Mark(NodeId id) {
+        if (nodes_[id].mark) {
+            return;
+        }
+        nodes_[id].mark = true;
+        for (NodeId child: nodes_[id].child) {
+            Mark(child);
+        }
+    }
+
+    NodeId Centre(NodeId id) {
+        const Node& node = nodes_[id];
+        NodeId nw = node.child[kNw], ne = node.child[kNe], sw = node.child[kSw], se = node.child[kSe];
+        return Join(nodes_[nw].child[kSe], nodes_[ne].child[kSw], nodes_[sw].child[kNe], nodes_[se].child[kNw]);
+    }
+
+    NodeId HorizontalCentre(NodeId west, NodeId east) {
+        const Node &w = nodes_[west], &e = nodes_[east];
+        return Join(w.child[kNe], e.child[kNw], w.child[kSe], e.child[kSw]);
+    }
+
+    NodeId VerticalCentre(NodeId north, NodeId south) {
+        const Node &n = nodes_[north], &s = nodes_[south];
+        return Join(n.child[kSw], n.child[kSe], s.child[kNw], s.child[kNe]);
+    }
+
+    // One generation of the centre of a 4x4 node, read off the block table of the rule.
+    NodeId BaseResult(NodeId id) {
+        const Node& node = nodes_[id];
+        uint32_t block = 0;
+        for (size_t quarter = 0; quarter < 4; ++quarter) {
+            const Node& child = nodes_[node.child[quarter]];
+            for (size_t k = 0; k < 4; ++k) {
+                const size_t row = 2 * (quarter / 2) + k / 2, col = 2 * (quarter % 2) + k % 2;
+                block |= static_cast<uint32_t> (child.child[k] == 1) << (4 * row + col);
+            }
+        }
+        const uint8_t centre = block_table_.Centre(block);
+        return Join(centre & 1, (centre >> 1) & 1, (centre >> 2) & 1, (centre >> 3) & 1);
+    }
+
+    // The centre half of a node advanced by 2^log_step generations, log_step <= level - 2. The node and the
+    // parts of it still being worked on are kept in roots_, so that garbage can be collected on the way in.
+    NodeId Result(NodeId id, unsigned log_step) {
+        if (nodes_[id].result_step == static_cast<int> (log_step)) {
+            return nodes_[id].result;
+        }
+
+        const unsigned level = nodes_[id].level;
+        NodeId result;
+        if (level == 2) {
+            result = BaseResult(id);
+        } else {
+            const size_t base = roots_.size();
+            roots_.push_back(id);
+            if (live_count_ > collect_at_) {
+                Collect();
+                // Should the step itself need most of the cache, let it grow rather than collect at every node.
+                collect_at_ = std::max(cache_nodes_, 2 * live_count_);
+            }
+
+            const Node& node = nodes_[id];
+            NodeId nw = node.child[kNw], ne = node.child[kNe], sw = node.child[kSw], se = node.child[kSe];
+            roots_.insert(roots_.end(), {nw, HorizontalCentre(nw, ne), ne,
+                                         VerticalCentre(nw, sw), Centre(id), VerticalCentre(ne, se),
+                                         sw, HorizontalCentre(sw, se), se});
+            NodeId* parts = &roots_[base + 1];
+            // At full speed the first half of the time is spent here, otherwise only the second round moves.
+            for (size_t k = 0; k < 9; ++k) {
+                const NodeId part = (log_step == level - 2 ? Result(parts[k], log_step - 1) : Centre(parts[k]));
+                parts = &roots_[base + 1];
+                parts[k] = part;
+            }
+
+            const unsigned inner_step = std::min(log_step, level - 3);
+            roots_.insert(roots_.end(), {Join(parts[0], parts[1], parts[3], parts[4]),
+                                         Join(parts[1], parts[2], parts[4], parts[5]),
+                                         Join(parts[3], parts[4], parts[6], parts[7]),
+                                         Join(parts[4], parts[5], parts[7], parts[8])});
+            for (size_t k = 0; k < 4; ++k) {
+                const NodeId quarter = Result(roots_[base + 10 + k], inner_step);
+                roots_[base + 10 + k] = quarter;
+            }
+            result = Join(roots_[base + 10], roots_[base + 11], roots_[base + 12], roots_[base + 13]);
+            roots_.resize(base);
+        }
+
+        nodes_[id].result = result;
+        nodes_[id].result_step = static_cast<int8_t> (log_step);
+        return result;
+    }
+
+    NodeId Build(const BitField& field, unsigned level, size_t row, size_t col) {
+        if (level == 0) {
+            return field.Get(row % height_, col % width_) ? 1 : 0;
+        }
+        if (level == 6 && width_ >= BitField::kWordBits) {
+            // A word-aligned 64x64 square: skip it quickly if it is empty.
+            bool empty = true;
+            for (size_t i = 0; i < BitField::kWordBits && empty; ++i) {
+                empty = field.Row((row + i) % height_)[(col % width_) / BitField::kWordBits] == 0;
+            }
+            if (empty) {
+                return empty_[level];
+            }
+        }
+
+        size_t half = size_t{1} << (level - 1);
+        return Join(Build(field, level - 1, row, col), Build(field, level - 1, row, col + half),
+                    Build(field, level - 1, row + half, col), Build(field, level - 1, row + half, col + half));
+    }
+
+    void Fill(BitField& field, NodeId id, unsigned level, size_t row, size_t col) const {
+        if (row >= height_ || col >= width_ || id == empty_[level]) {
+            return;
+        }
+        if (level == 0) {
+            field.Set(row, col, true);
+            return;
+        }
+
+        size_t half = size_t{1} << (level - 1);
+        const Node& node = nodes_[id];
+        Fill(field, node.child[kNw], level - 1, row, col);
+        Fill(field, node.child[kNe], level - 1, row, col + half);
+        Fill(field, node.child[kSw], level - 1, row + half, col);
+        Fill(field, node.child[kSe], level - 1, row + half, col + half);
+    }
+
+    const size_t cache_nodes_;
+    size_t collect_at_; // live nodes above which a step collects garbage
+    const life::BlockTable block_table_;
+
+    std::vector<Node> nodes_;
+    std::vector<NodeId> buckets_;
+    std::vector<NodeId> empty_; // the empty node of every level
+    std::vector<NodeId> roots_; // nodes a step in progress still needs
+    NodeId free_{kNone};
+    size_t live_count_{0};
+
+    NodeId torus_{0};
+    unsigned torus_level_{0};
+    size_t height_{0}, width_{0};
+};
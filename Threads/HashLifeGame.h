@@ -0,0 +1,146 @@
+#pragma once
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "BitField.h"
+#include "Checkpointer.h"
+#include "FieldIO.h"
+#include "Game.h"
+#include "GameOptions.h"
+#include "HashLife.h"
+#include "RunStats.h"
+
+// Runs a HashLife universe in a background thread. RUN n is split into steps of 2^j generations, largest first;
+// a step that is still in flight when the game is stopped is thrown away.
+class HashLifeGame : public Game {
+public:
+    HashLifeGame(const BitField& start_field, const GameOptions& options, const size_t generation = 0)
+            : universe_{options.cache_nodes, options.rule}, options_(options), required_iter_{generation},
+              done_iter_{generation}, first_iter_{generation} {
+        universe_.SetTorus(start_field);
+        thread_ = std::thread(&HashLifeGame::ThreadCycle, this);
+    }
+
+    // Waits for the step in flight, since the universe is only read out between steps, but not for the rest of
+    // the run.
+    void RequestStatus(const FieldView& view) override {
+        BitField field;
+        size_t generation;
+        {
+            std::lock_guard universe_lock{universe_mutex_};
+            std::lock_guard lock{change_iterations_};
+            field = universe_.GetTorus();
+            generation = done_iter_;
+        }
+        if (view.raw) {
+            FieldPrinter::WriteRaw(field, view, generation);
+            return;
+        }
+        std::cout << "Done " << generation << " iteration(s). Current field:\n";
+        PrintField(field, view);
+    }
+
+    // A single thread steps the universe, so there is nothing to wait for but RUN.
+    void RequestStats() override {
+        std::lock_guard lock{change_iterations_};
+        RunStats stats;
+        stats.generations = done_iter_ - first_iter_;
+        stats.seconds = compute_ns_ / 1e9;
+        stats.workers.resize(1);
+        stats.workers[0].compute_ns = compute_ns_;
+        stats.Print(std::cout);
+    }
+
+    void Run(const size_t iteration_count) override {
+        std::lock_guard lock{change_iterations_};
+
+        required_iter_ += iteration_count;
+        can_iterate_.notify_one();
+    }
+
+    void Stop() override {
+        std::lock_guard lock{change_iterations_};
+        required_iter_ = done_iter_;
+    }
+
+    void Quit() override {
+        Stop();
+        {
+            std::lock_guard lock{change_iterations_};
+
+            quit_ = true;
+            can_iterate_.notify_one();
+        }
+        thread_.join();
+        checkpointer_.Wait();
+    }
+
+    // Waits for the step in flight, as RequestStatus does.
+    void Save(const std::string& path) override {
+        std::lock_guard universe_lock{universe_mutex_};
+        std::lock_guard lock{change_iterations_};
+        checkpointer_.Acquire(true);
+        checkpointer_.Snapshot() = universe_.GetTorus();
+        checkpointer_.Start(done_iter_, path);
+    }
+
+private:
+    void ThreadCycle() {
+        while (true) {
+            size_t remaining;
+            {
+                std::unique_lock lock{change_iterations_};
+                can_iterate_.wait(lock, [this] { return required_iter_ > done_iter_ || quit_; });
+
+                if (quit_) {
+                    return;
+                }
+                remaining = required_iter_ - done_iter_;
+            }
+
+            unsigned log_step = 0;
+            while (log_step < HashLife::kMaxLogStep && (remaining >> (log_step + 1)) != 0) {
+                ++log_step;
+            }
+
+            std::lock_guard universe_lock{universe_mutex_};
+            HashLife::NodeId before = universe_.Root();
+            uint64_t step_start = NowNs();
+            universe_.StepTorus(log_step);
+            {
+                std::lock_guard lock{change_iterations_};
+                compute_ns_ += NowNs() - step_start;
+                if (required_iter_ - done_iter_ >= (size_t{1} << log_step)) {
+                    done_iter_ += size_t{1} << log_step;
+                    // A checkpoint that comes due while the previous one is still being written is skipped.
+                    size_t interval = options_.checkpoint_interval;
+                    if (interval > 0 && done_iter_ / interval != (done_iter_ - (size_t{1} << log_step)) / interval &&
+                        checkpointer_.Acquire(false)) {
+                        checkpointer_.Snapshot() = universe_.GetTorus();
+                        checkpointer_.Start(done_iter_, options_.checkpoint_path);
+                    }
+                } else {
+                    universe_.SetRoot(before);
+                }
+            }
+            universe_.CollectGarbage();
+        }
+    }
+
+    HashLife universe_;
+    GameOptions options_;
+    Checkpointer checkpointer_;
+    std::mutex universe_mutex_; // held while the universe is stepped or read
+    std::thread thread_;
+
+    std::mutex change_iterations_;
+    std::condition_variable can_iterate_;
+
+    size_t required_iter_{0}, done_iter_{0};
+    size_t first_iter_{0};
+    uint64_t compute_ns_{0};
+    bool quit_{false};
+};
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include "BitField.h"
+#include "LifeKernel.h"
+
+// Life on the unbounded plane. Live cells are kept in chunks of 64 x 64 cells, one word per row, found through a
+// hash map by their position; chunks come from a pool as activity reaches them and go back to it once they and
+// the edges facing them are dead, so memory and time follow the population rather than its bounding box.
+class SparseLife {
+public:
+    typedef BitField::Word Word;
+
+    static constexpr size_t kChunkSide = BitField::kWordBits;
+
+    explicit SparseLife(const life::Rule& rule = life::kConwayRule) {
+        life::VisitRule(rule, [this](auto fixed) { step_chunk_ = &StepChunk<decltype(fixed)>; });
+    }
+
+    // Places the field with its top left cell at row 0, column 0 of an otherwise dead plane.
+    void SetField(const BitField& field) {
+        for (size_t i = 0; i < field.Height(); ++i) {
+            const Word* row = field.Row(i);
+            for (size_t w = 0; w < field.WordsPerRow(); ++w) {
+                if (row[w] != 0) {
+                    pool_[GetOrCreate(static_cast<int64_t> (i / kChunkSide), static_cast<int64_t> (w))]
+                            .cells[current_][i % kChunkSide] = row[w];
+                }
+            }
+        }
+    }
+
+    // One generation.
+    void Step() {
+        Expand();
+        for (ChunkId id: chunks_) {
+            Chunk& chunk = pool_[id];
+            const Word* around[9];
+            for (int k = 0; k < 9; ++k) {
+                ChunkId neighbour = Find(chunk.row + k / 3 - 1, chunk.col + k % 3 - 1);
+                around[k] = neighbour == kNone ? kDeadRows : pool_[neighbour].cells[current_];
+            }
+            step_chunk_(around, chunk.cells[current_ ^ 1]);
+        }
+        current_ ^= 1;
+    }
+
+    // The smallest field holding every live cell and the plane position of its top left cell; an empty field
+    // if nothing is alive.
+    BitField GetField(int64_t& top, int64_t& left) const {
+        int64_t row_min = std::numeric_limits<int64_t>::max(), row_max = std::numeric_limits<int64_t>::min();
+        int64_t col_min = row_min, col_max = row_max;
+        for (ChunkId id: chunks_) {
+            const Chunk& chunk = pool_[id];
+            Word columns = 0;
+            for (size_t r = 0; r < kChunkSide; ++r) {
+                if (chunk.cells[current_][r] != 0) {
+                    row_min = std::min(row_min, chunk.row * kSide + static_cast<int64_t> (r));
+                    row_max = std::max(row_max, chunk.row * kSide + static_cast<int64_t> (r));
+                    columns |= chunk.cells[current_][r];
+                }
+            }
+            if (columns != 0) {
+                col_min = std::min(col_min, chunk.col * kSide + __builtin_ctzll(columns));
+                col_max = std::max(col_max, chunk.col * kSide + kHigh - __builtin_clzll(columns));
+            }
+        }
+        if (row_min > row_max) {
+            top = left = 0;
+            return BitField();
+        }
+
+        top = row_min, left = col_min;
+        BitField field(static_cast<size_t> (row_max - row_min + 1), static_cast<size_t> (col_max - col_min + 1));
+        for (ChunkId id: chunks_) {
+            const Chunk& chunk = pool_[id];
+            for (size_t r = 0; r < kChunkSide; ++r) {
+                Word bits = chunk.cells[current_][r];
+                for (; bits != 0; bits &= bits - 1) {
+                    field.Set(static_cast<size_t> (chunk.row * kSide + static_cast<int64_t> (r) - top),
+                              static_cast<size_t> (chunk.col * kSide + __builtin_ctzll(bits) - left), true);
+                }
+            }
+        }
+        return field;
+    }
+
+    size_t Population() const {
+        size_t population = 0;
+        for (ChunkId id: chunks_) {
+            for (Word row: pool_[id].cells[current_]) {
+                population += __builtin_popcountll(row);
+            }
+        }
+        return population;
+    }
+
+    size_t ChunkCount() const {
+        return chunks_.size();
+    }
+
+private:
+    typedef uint32_t ChunkId;
+    typedef void (*ChunkStepper)(const Word* const around[9], Word* out);
+
+    static constexpr ChunkId kNone = std::numeric_limits<ChunkId>::max();
+    static constexpr int64_t kSide = kChunkSide;
+    static constexpr int kHigh = kChunkSide - 1;
+    static constexpr size_t kMinFreeChunks = 256; // free chunks kept in the pool in any case
+    static constexpr Word kDeadRows[kChunkSide] = {};
+
+    struct Chunk {
+        int64_t row, col;           // position on the plane, in chunks
+        Word cells[2][kChunkSide];  // both generations, the current one is cells[current_]
+        bool needed;
+    };
+
+    // The next generation of the centre chunk of around, a 3 x 3 square of chunks given row by row.
+    template<typename R>
+    static void StepChunk(const Word* const around[9], Word* out) {
+        Word west[kChunkSide + 2], mid[kChunkSide + 2], east[kChunkSide + 2];
+        for (size_t r = 0; r < kChunkSide + 2; ++r) {
+            const size_t band = r == 0 ? 0 : (r == kChunkSide + 1 ? 6 : 3);
+            const size_t row = r == 0 ? kChunkSide - 1 : (r == kChunkSide + 1 ? 0 : r - 1);
+            west[r] = around[band][row], mid[r] = around[band + 1][row], east[r] = around[band + 2][row];
+        }
+
+        Word west_of[kChunkSide + 2], east_of[kChunkSide + 2];
+        for (size_t r = 0; r < kChunkSide + 2; ++r) {
+            west_of[r] = (mid[r] << 1) | (west[r] >> kHigh);
+            east_of[r] = (mid[r] >> 1) | (east[r] << kHigh);
+        }
+        for (size_t r = 1; r <= kChunkSide; ++r) {
+            out[r - 1] = life::NextCells<R>(west_of[r - 1], mid[r - 1], east_of[r - 1], west_of[r], mid[r], east_of[r],
+                                            west_of[r + 1], mid[r + 1], east_of[r + 1]);
+        }
+    }
+
+    static uint64_t Key(int64_t row, int64_t col) {
+        return (static_cast<uint64_t> (row) << 32) ^ static_cast<uint32_t> (col);
+    }
+
+    ChunkId Find(int64_t row, int64_t col) const {
+        auto it = index_.find(Key(row, col));
+        return it == index_.end() ? kNone : it->second;
+    }
+
+    ChunkId GetOrCreate(int64_t row, int64_t col) {
+        auto [it, inserted] = index_.try_emplace(Key(row, col), kNone);
+        if (!inserted) {
+            return it->second;
+        }
+        ChunkId id;
+        if (!free_.empty()) {
+            id = free_.back();
+            free_.pop_back();
+        } else {
+            id = static_cast<ChunkId> (pool_.size());
+            pool_.emplace_back();
+        }
+        Chunk& chunk = pool_[id];
+        chunk.row = row, chunk.col = col, chunk.needed = true;
+        std::fill(chunk.cells[0], chunk.cells[0] + 2 * kChunkSide, 0);
+        it->second = id;
+        chunks_.push_back(id);
+        return id;
+    }
+
+    // Makes room for the cells that may be born next generation and gives back the chunks that stay dead:
+    // a chunk is kept if it is alive or a neighbour has live cells on the edge or corner facing it.
+    void Expand() {
+        for (ChunkId id: chunks_) {
+            pool_[id].needed = false;
+        }
+        const size_t count = chunks_.size();
+        for (size_t k = 0; k < count; ++k) {
+            const Chunk& chunk = pool_[chunks_[k]];
+            const Word* cells = chunk.cells[current_];
+            Word any = 0, west = 0, east = 0;
+            for (size_t r = 0; r < kChunkSide; ++r) {
+                any |= cells[r], west |= cells[r] & 1, east |= cells[r] >> kHigh;
+            }
+            if (any == 0) {
+                continue;
+            }
+            const int64_t row = chunk.row, col = chunk.col;
+            const Word top = cells[0], bottom = cells[kChunkSide - 1];
+            const bool edges[9] = {(top & 1) != 0, top != 0, (top >> kHigh) != 0,
+                                   west != 0, true, east != 0,
+                                   (bottom & 1) != 0, bottom != 0, (bottom >> kHigh) != 0};
+            // The pool may grow from here on, so chunk is not to be used any more.
+            for (int d = 0; d < 9; ++d) {
+                if (edges[d]) {
+                    pool_[GetOrCreate(row + d / 3 - 1, col + d % 3 - 1)].needed = true;
+                }
+            }
+        }
+
+        for (size_t k = 0; k < chunks_.size();) {
+            const ChunkId id = chunks_[k];
+            if (pool_[id].needed) {
+                ++k;
+                continue;
+            }
+            index_.erase(Key(pool_[id].row, pool_[id].col));
+            free_.push_back(id);
+            chunks_[k] = chunks_.back();
+            chunks_.pop_back();
+        }
+        Shrink();
+    }
+
+    // Once most of the pool is free, as after a large transient, moves the chunks in use to a pool of their own
+    // and gives the rest back.
+    void Shrink() {
+        if (free_.size() <= 2 * chunks_.size() + kMinFreeChunks) {
+            return;
+        }
+        std::vector<Chunk> pool;
+        pool.reserve(chunks_.size());
+        for (ChunkId& id: chunks_) {
+            pool.push_back(pool_[id]);
+            id = static_cast<ChunkId> (pool.size() - 1);
+            index_[Key(pool.back().row, pool.back().col)] = id;
+        }
+        pool_.swap(pool);
+        free_ = std::vector<ChunkId>();
+        index_.rehash(0);
+    }
+
+    ChunkStepper step_chunk_{nullptr};
+    std::vector<Chunk> pool_;
+    std::vector<ChunkId> free_;   // pool entries not in use
+    std::vector<ChunkId> chunks_; // pool entries in use
+    std::unordered_map<uint64_t, ChunkId> index_;
+    size_t current_{0};
+};
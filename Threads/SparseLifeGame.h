@@ -0,0 +1,142 @@
+#pragma once
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include "BitField.h"
+#include "Checkpointer.h"
+#include "FieldIO.h"
+#include "Game.h"
+#include "GameOptions.h"
+#include "RunStats.h"
+#include "SparseLife.h"
+
+// Runs a SparseLife plane in a background thread, a generation at a time. STATUS and SAVE see the smallest
+// field holding every live cell; where it lies on the plane is only printed by STATUS, SAVE drops it.
+class SparseLifeGame : public Game {
+public:
+    SparseLifeGame(const BitField& start_field, const GameOptions& options, const size_t generation = 0)
+            : universe_{options.rule}, options_(options), required_iter_{generation}, done_iter_{generation},
+              first_iter_{generation} {
+        universe_.SetField(start_field);
+        thread_ = std::thread(&SparseLifeGame::ThreadCycle, this);
+    }
+
+    // Waits for the generation in flight, since the plane is only read out between generations.
+    void RequestStatus(const FieldView& view) override {
+        BitField field;
+        int64_t top, left;
+        size_t generation, population, chunks;
+        {
+            std::lock_guard universe_lock{universe_mutex_};
+            std::lock_guard lock{change_iterations_};
+            field = universe_.GetField(top, left);
+            generation = done_iter_;
+            population = universe_.Population();
+            chunks = universe_.ChunkCount();
+        }
+        if (view.raw) {
+            FieldPrinter::WriteRaw(field, view, generation);
+            return;
+        }
+        std::cout << "Done " << generation << " iteration(s). Current field:\n";
+        PrintField(field, view);
+        std::cout << population << " live cell(s) in " << chunks << " chunk(s) of " << SparseLife::kChunkSide
+                  << " x " << SparseLife::kChunkSide << ", the field starts at row " << top << ", column " << left
+                  << " of the plane.\n";
+    }
+
+    // A single thread steps the plane, so there is nothing to wait for but RUN.
+    void RequestStats() override {
+        std::lock_guard lock{change_iterations_};
+        RunStats stats;
+        stats.generations = done_iter_ - first_iter_;
+        stats.seconds = compute_ns_ / 1e9;
+        stats.workers.resize(1);
+        stats.workers[0].compute_ns = compute_ns_;
+        stats.Print(std::cout);
+    }
+
+    void Run(const size_t iteration_count) override {
+        std::lock_guard lock{change_iterations_};
+
+        required_iter_ += iteration_count;
+        can_iterate_.notify_one();
+    }
+
+    void Stop() override {
+        std::lock_guard lock{change_iterations_};
+        required_iter_ = done_iter_;
+    }
+
+    void Quit() override {
+        Stop();
+        {
+            std::lock_guard lock{change_iterations_};
+
+            quit_ = true;
+            can_iterate_.notify_one();
+        }
+        thread_.join();
+        checkpointer_.Wait();
+    }
+
+    // Waits for the generation in flight, as RequestStatus does.
+    void Save(const std::string& path) override {
+        std::lock_guard universe_lock{universe_mutex_};
+        std::lock_guard lock{change_iterations_};
+        int64_t top, left;
+        checkpointer_.Acquire(true);
+        checkpointer_.Snapshot() = universe_.GetField(top, left);
+        checkpointer_.Start(done_iter_, path);
+    }
+
+private:
+    void ThreadCycle() {
+        while (true) {
+            {
+                std::unique_lock lock{change_iterations_};
+                can_iterate_.wait(lock, [this] { return required_iter_ > done_iter_ || quit_; });
+
+                if (quit_) {
+                    return;
+                }
+            }
+
+            std::lock_guard universe_lock{universe_mutex_};
+            uint64_t step_start = NowNs();
+            universe_.Step();
+            {
+                std::lock_guard lock{change_iterations_};
+                compute_ns_ += NowNs() - step_start;
+                ++done_iter_;
+                if (required_iter_ < done_iter_) { // stopped while the generation was computed
+                    required_iter_ = done_iter_;
+                }
+                // A checkpoint that comes due while the previous one is still being written is skipped.
+                size_t interval = options_.checkpoint_interval;
+                if (interval > 0 && done_iter_ % interval == 0 && checkpointer_.Acquire(false)) {
+                    int64_t top, left;
+                    checkpointer_.Snapshot() = universe_.GetField(top, left);
+                    checkpointer_.Start(done_iter_, options_.checkpoint_path);
+                }
+            }
+        }
+    }
+
+    SparseLife universe_;
+    GameOptions options_;
+    Checkpointer checkpointer_;
+    std::mutex universe_mutex_; // held while the plane is stepped or read
+    std::thread thread_;
+
+    std::mutex change_iterations_;
+    std::condition_variable can_iterate_;
+
+    size_t required_iter_{0}, done_iter_{0};
+    size_t first_iter_{0};
+    uint64_t compute_ns_{0};
+    bool quit_{false};
+};
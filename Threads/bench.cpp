@@ -0,0 +1,144 @@
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "BenchReport.h"
+#include "Ensemble.h"
+#include "GameOfLife.h"
+#include "GameOptions.h"
+#include "LifeKernel.h"
+
+// Headless benchmark of the kernels and of the threaded engine on seeded fields. Prints one JSON object per
+// line. Usage: bench [generations] [max_threads]
+
+namespace {
+
+const double kDensities[] = {0.05, 0.35, 0.5};
+const uint64_t kSeed = 20240601;
+
+// One thread stepping the whole torus, a generation at a time.
+template<typename R = life::Conway>
+void BenchStepTorus(size_t side, double density, size_t generations) {
+    BitField cur = bench::SeededField(side, side, density, kSeed), next(side, side);
+    bench::Latencies latencies;
+    for (size_t g = 0; g < generations; ++g) {
+        auto start = bench::Clock::now();
+        life::StepTorus<R>(cur, next, 0, side, 0, cur.WordsPerRow());
+        latencies.Add(bench::SecondsSince(start));
+        std::swap(cur, next);
+    }
+    bench::JsonLine("kernel").Add("kernel", "step_torus").Add("rule", life::RuleName({R::birth, R::survival}))
+            .Add("height", side).Add("width", side).Add("density", density).Add("threads", size_t{1})
+            .Add("generations", generations).AddRun(side, side, latencies, generations).Print();
+}
+
+// One thread stepping the default tiles depth generations at a time, as GameOfLife::ComputePiece does.
+void BenchStepTile(size_t side, double density, size_t generations, size_t depth) {
+    BitField cur = bench::SeededField(side, side, density, kSeed), next(side, side);
+    GameOptions defaults;
+    const size_t tile_words = defaults.tile_cols / BitField::kWordBits;
+    life::TileScratch scratch;
+    bench::Latencies latencies;
+    for (size_t g = 0; g < generations; g += depth) {
+        const size_t steps = std::min(depth, generations - g); // the last block may be short
+        auto start = bench::Clock::now();
+        for (size_t row = 0; row < side; row += defaults.tile_rows) {
+            for (size_t w = 0; w < cur.WordsPerRow(); w += tile_words) {
+                life::StepTorusTile<life::Conway>(cur, next, row, std::min(side, row + defaults.tile_rows), w,
+                                                  std::min(cur.WordsPerRow(), w + tile_words), steps, scratch);
+            }
+        }
+        double seconds = bench::SecondsSince(start);
+        for (size_t s = 0; s < steps; ++s) {
+            latencies.Add(seconds / steps);
+        }
+        std::swap(cur, next);
+    }
+    bench::JsonLine("kernel").Add("kernel", "step_torus_tile").Add("halo", depth).Add("height", side)
+            .Add("width", side).Add("density", density).Add("threads", size_t{1})
+            .Add("generations", generations).AddRun(side, side, latencies, generations).Print();
+}
+
+// The whole engine, one RUN 1 per generation, waiting for each to be published.
+bench::Latencies RunEngine(size_t thread_count, size_t height, size_t width, double density, size_t generations) {
+    GameOfLife game(thread_count, bench::SeededField(height, width, density, kSeed), GameOptions{});
+    bench::Latencies latencies;
+    for (size_t g = 1; g <= generations; ++g) {
+        auto start = bench::Clock::now();
+        game.Run(1);
+        while (game.DoneIterations() < g) {
+            std::this_thread::yield();
+        }
+        latencies.Add(bench::SecondsSince(start));
+    }
+    game.Quit();
+    return latencies;
+}
+
+// Strong scaling keeps the field, weak scaling gives every thread the same share of a growing field.
+void BenchScaling(const std::vector<size_t>& thread_counts, double density, size_t generations) {
+    const size_t side = 2048, share = 1024;
+    double strong_base = 0, weak_base = 0;
+    for (size_t threads: thread_counts) {
+        bench::Latencies latencies = RunEngine(threads, side, side, density, generations);
+        double rate = static_cast<double> (side) * side * generations / latencies.Total();
+        strong_base = strong_base == 0 ? rate : strong_base;
+        bench::JsonLine("strong_scaling").Add("height", side).Add("width", side).Add("density", density)
+                .Add("threads", threads).Add("generations", generations)
+                .AddRun(side, side, latencies, generations).Add("speedup", rate / strong_base)
+                .Add("efficiency", rate / strong_base / threads).Print();
+
+        latencies = RunEngine(threads, share * threads, share, density, generations);
+        double seconds = latencies.Total();
+        weak_base = weak_base == 0 ? seconds : weak_base;
+        bench::JsonLine("weak_scaling").Add("height", share * threads).Add("width", share)
+                .Add("density", density).Add("threads", threads).Add("generations", generations)
+                .AddRun(share * threads, share, latencies, generations).Add("efficiency", weak_base / seconds)
+                .Print();
+    }
+}
+
+// BATCH of small random boards, the whole batch timed at once.
+void BenchEnsemble(size_t threads, size_t boards, size_t side, size_t generations) {
+    auto start = bench::Clock::now();
+    RunEnsemble(threads, boards, side, side, kSeed, generations, life::kConwayRule);
+    double seconds = bench::SecondsSince(start);
+    bench::JsonLine("ensemble").Add("boards", boards).Add("height", side).Add("width", side)
+            .Add("threads", threads).Add("generations", generations).Add("seconds", seconds)
+            .Add("boards_per_sec", boards / seconds).Print();
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    size_t generations = argc > 1 ? std::stoul(argv[1]) : 32;
+    size_t max_threads = argc > 2 ? std::stoul(argv[2]) : std::max(1u, std::thread::hardware_concurrency());
+
+    for (size_t side: {256, 1024, 4096}) {
+        for (double density: kDensities) {
+            BenchStepTorus(side, density, generations);
+            BenchStepTile(side, density, generations, 4);
+        }
+    }
+    for (const life::Rule& rule: life::kCompiledRules) {
+        life::VisitRule(rule, [generations](auto fixed) {
+            BenchStepTorus<decltype(fixed)>(1024, 0.35, generations);
+        });
+    }
+
+    BenchEnsemble(1, 4 * Ensemble::kBoards, 64, generations);
+    if (max_threads > 1) {
+        BenchEnsemble(max_threads, 4 * Ensemble::kBoards * max_threads, 64, generations);
+    }
+
+    std::vector<size_t> thread_counts;
+    for (size_t threads = 1; threads < max_threads; threads *= 2) {
+        thread_counts.push_back(threads);
+    }
+    thread_counts.push_back(max_threads);
+    for (double density: kDensities) {
+        BenchScaling(thread_counts, density, generations);
+    }
+    return 0;
+}